@@ -0,0 +1,154 @@
+#ifndef arena_h
+#define arena_h
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <new>
+#include <utility>
+
+#include "stats.h"
+
+// The strictest fundamental alignment; gcc 4.8's library has no std::max_align_t.
+union ArenaMaxAlign {
+    long double ld;
+    long long ll;
+    void * p;
+};
+
+// Monotonic arena: allocation bumps a pointer in the current block, nothing
+// is freed individually, and release() (or the destructor) drops every block
+// at once. For data that lives exactly as long as its owner: a parse, a run
+// of the counters, a batch.
+class Arena {
+public:
+    explicit Arena(std::size_t block_size = 16 * 1024) : block_size_(block_size) {}
+
+    ~Arena() {
+        release();
+    }
+
+    Arena(Arena const &) = delete;
+    Arena & operator=(Arena const &) = delete;
+
+    void * allocate(std::size_t size, std::size_t align = alignof(ArenaMaxAlign)) {
+        std::size_t pad = (align - reinterpret_cast<std::size_t>(cur) % align) % align;
+        if (cur == nullptr || size + pad > static_cast<std::size_t>(end - cur)) {
+            grow(size + align);
+            pad = (align - reinterpret_cast<std::size_t>(cur) % align) % align;
+        }
+        void * p = cur + pad;
+        cur += pad + size;
+        used_ += pad + size;
+        if (used_ > peak_) peak_ = used_;
+        return p;
+    }
+
+    void release() {
+        stats_arena(-static_cast<std::int64_t>(reserved));
+        while (head) {
+            Block * next = head->next;
+            ::operator delete(head);
+            head = next;
+        }
+        cur = end = nullptr;
+        used_ = 0;
+        reserved = 0;
+    }
+
+    // bytes handed out since the last release, and the most ever
+    std::size_t used() const { return used_; }
+    std::size_t peak() const { return peak_; }
+
+private:
+    struct Block {
+        Block * next;
+    };
+
+    std::size_t block_size_;
+    Block * head = nullptr;
+    char * cur = nullptr;
+    char * end = nullptr;
+    std::size_t used_ = 0;
+    std::size_t peak_ = 0;
+    std::size_t reserved = 0;
+
+    // blocks double up to 1MB; oversized requests get a block of their own
+    void grow(std::size_t at_least) {
+        std::size_t size = block_size_;
+        if (block_size_ < (1 << 20)) block_size_ *= 2;
+        if (size < at_least + sizeof(Block)) size = at_least + sizeof(Block);
+        Block * b = static_cast<Block *>(::operator new(size));
+        b->next = head;
+        head = b;
+        cur = reinterpret_cast<char *>(b) + sizeof(Block);
+        end = reinterpret_cast<char *>(b) + size;
+        reserved += size;
+        stats_arena(static_cast<std::int64_t>(size));
+    }
+};
+
+// Standard allocator drawing from an Arena; deallocate is a no-op. Spells
+// out the C++03 members too, which gcc 4.8's containers use directly instead
+// of going through allocator_traits.
+template <class T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+    typedef T * pointer;
+    typedef T const * const_pointer;
+    typedef T & reference;
+    typedef T const & const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template <class U>
+    struct rebind {
+        typedef ArenaAllocator<U> other;
+    };
+
+    explicit ArenaAllocator(Arena & arena) : arena_(&arena) {}
+
+    template <class U>
+    ArenaAllocator(ArenaAllocator<U> const & other) : arena_(other.arena()) {}
+
+    T * allocate(std::size_t n) {
+        return static_cast<T *>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, std::size_t) {}
+
+    template <class U, class... Args>
+    void construct(U * p, Args &&... args) {
+        ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+    }
+
+    template <class U>
+    void destroy(U * p) {
+        p->~U();
+    }
+
+    size_type max_size() const {
+        return static_cast<size_type>(-1) / sizeof(T);
+    }
+
+    Arena * arena() const { return arena_; }
+
+private:
+    Arena * arena_;
+};
+
+template <class T, class U>
+bool operator==(ArenaAllocator<T> const & a, ArenaAllocator<U> const & b) {
+    return a.arena() == b.arena();
+}
+
+template <class T, class U>
+bool operator!=(ArenaAllocator<T> const & a, ArenaAllocator<U> const & b) {
+    return a.arena() != b.arena();
+}
+
+template <class K, class V, class Compare = std::less<K>>
+using ArenaMap = std::map<K, V, Compare, ArenaAllocator<std::pair<K const, V>>>;
+
+#endif
@@ -0,0 +1,393 @@
+// Throughput of the kernels and of end-to-end runs on generated corpora.
+//
+//   bench-kernels <corpus.itx> <corpus.rtf> [--json FILE] [--baseline FILE] [--threshold F] [--runs N]
+//
+// Prints MB/s per benchmark (the best of N runs, default 3), optionally saves
+// them as JSON, and exits with 1 if any benchmark is more than F (default
+// 0.15) slower than in the baseline, or if the counters allocate in their
+// per-line path.
+// Stage figures (keyword lookup, line classification...) come from the --stats
+// sampler over an extra end-to-end run; small stages get only a handful of
+// samples, so they are reported but not compared.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <regex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "encodings.h"
+#include "meter.h"
+#include "rtfparser.h"
+#include "sb-itx-sloka-counter.h"
+#include "sb-sloka-counter.h"
+#include "stats.h"
+#include "verse-stream.h"
+
+#ifdef _WIN32
+#include <io.h>
+static char const null_device[] = "NUL";
+#else
+#include <unistd.h>
+static char const null_device[] = "/dev/null";
+#endif
+
+class NullOutputter {
+public:
+    void write(std::string const &, CHP const &) {}
+};
+
+// collects font 0 lines, i.e. what SbSlokaCounter sees
+class LineCollector {
+public:
+    void write(std::string const & string, CHP const & chp) {
+        if (int(chp.cur_font) != 0) return;
+        for (char c: string) {
+            if (c == '\n') {
+                if (!cur.empty()) lines.push_back(cur);
+                cur.clear();
+            } else {
+                cur += c;
+            }
+        }
+    }
+
+    std::vector<std::string> lines;
+
+private:
+    std::string cur;
+};
+
+static int runs = 3;
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <class F>
+static double best_of(F f) {
+    double best = 1e100;
+    for (int i = 0; i < runs; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        best = std::min(best, seconds_since(start));
+    }
+    return best;
+}
+
+static std::size_t total_size(std::vector<std::string> const & lines) {
+    std::size_t size = 0;
+    for (auto & l: lines) size += l.size();
+    return size;
+}
+
+static std::vector<std::string> itx_verse_lines(char const * name) {
+    std::ifstream f(name);
+    static std::regex r(R"RE(^\d{8} (.*?)(?: *#|$))RE");
+    std::vector<std::string> lines;
+    std::string line;
+    std::smatch m;
+    while (std::getline(f, line)) {
+        if (std::regex_search(line, m, r)) lines.push_back(m.str(1));
+    }
+    return lines;
+}
+
+// Counts heap allocations between consecutive lines of the same verse, i.e.
+// in the per-line path once the chapter and verse are set up. Used as the
+// counters' line sink; allocations come from the --stats counter.
+class AllocationCheck {
+public:
+    void line(std::uint32_t id) {
+        auto now = run_stats.get(StatCounter::allocations);
+        if (id == prev_id) {
+            ++lines;
+            allocations += now - prev_allocations;
+        }
+        prev_id = id;
+        prev_allocations = now;
+    }
+
+    // false if any line allocated
+    bool report(char const * name) const {
+        printf("%-28s %10llu allocations in %llu lines\n", name,
+               static_cast<unsigned long long>(allocations), static_cast<unsigned long long>(lines));
+        return allocations == 0;
+    }
+
+private:
+    std::uint32_t prev_id = 0;
+    std::uint64_t prev_allocations = 0;
+    std::uint64_t lines = 0;
+    std::uint64_t allocations = 0;
+};
+
+template <class Counter>
+static void check_allocations(Counter & c, AllocationCheck & check) {
+    c.set_line_sink([&check](std::uint32_t id, int, bool, std::string const &) {
+        check.line(id);
+    });
+}
+
+static long file_size(char const * name) {
+    FILE *f = fopen(name, "rb");
+    if (!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+class Bench {
+public:
+    void add(std::string const & name, double bytes, double seconds, bool compared = true) {
+        double mbps = seconds > 0 ? bytes / seconds / (1 << 20) : 0;
+        results[name] = mbps;
+        if (!compared) sampled.insert(name);
+        printf("%-28s %10.1f MB/s\n", name.c_str(), mbps);
+    }
+
+    // stage shares from the sampler, as throughput over the whole input
+    void add_stages(std::string const & prefix, double bytes, std::vector<Stage> const & stages) {
+        for (auto s: stages) {
+            double seconds = stage_seconds[static_cast<int>(s)];
+            if (seconds > 0) add(prefix + RunStats::name(s), bytes, seconds, false);
+        }
+    }
+
+    template <class F>
+    void sample_stages(F f) {
+        run_stats.start();
+        f();
+        run_stats.stop();
+        for (int s = 0; s < RunStats::stages; ++s) {
+            stage_seconds[s] = run_stats.stage_wall_seconds(static_cast<Stage>(s));
+        }
+    }
+
+    bool write_json(char const * name) const {
+        FILE *f = fopen(name, "w");
+        if (!f) return false;
+        fprintf(f, "{");
+        bool first = true;
+        for (auto & r: results) {
+            fprintf(f, "%s\n  \"%s\": %.2f", first ? "" : ",", r.first.c_str(), r.second);
+            first = false;
+        }
+        fprintf(f, "\n}\n");
+        return fclose(f) == 0;
+    }
+
+    // true if nothing is slower than baseline by more than threshold
+    bool compare(char const * name, double threshold) const {
+        std::ifstream f(name);
+        if (!f) {
+            printf("no baseline in %s, nothing to compare\n", name);
+            return true;
+        }
+        std::string json((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+        static std::regex r(R"re("(\w+)": ([0-9.]+))re");
+        bool ok = true;
+        for (std::sregex_iterator it(json.begin(), json.end(), r), end; it != end; ++it) {
+            auto found = results.find(it->str(1));
+            if (found == results.end() || sampled.count(found->first)) continue;
+            double base = std::atof(it->str(2).c_str());
+            if (found->second < base * (1 - threshold)) {
+                printf("REGRESSION %s: %.1f MB/s, baseline %.1f MB/s\n",
+                       found->first.c_str(), found->second, base);
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+private:
+    std::map<std::string, double> results;
+    std::set<std::string> sampled;
+    double stage_seconds[RunStats::stages] = {};
+};
+
+int main(int argc, char * argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: bench-kernels <corpus.itx> <corpus.rtf> [--json FILE]"
+                     " [--baseline FILE] [--threshold F] [--runs N]\n";
+        return 1;
+    }
+    char const * itx_name = argv[1];
+    char const * rtf_name = argv[2];
+    char const * json_name = nullptr;
+    char const * baseline_name = nullptr;
+    double threshold = 0.15;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--json") json_name = argv[i + 1];
+        else if (opt == "--baseline") baseline_name = argv[i + 1];
+        else if (opt == "--threshold") threshold = std::atof(argv[i + 1]);
+        else if (opt == "--runs") runs = std::max(1, std::atoi(argv[i + 1]));
+        else {
+            std::cerr << "unknown option: " << opt << '\n';
+            return 1;
+        }
+    }
+
+    long itx_size = file_size(itx_name);
+    long rtf_size = file_size(rtf_name);
+    if (itx_size < 0 || rtf_size < 0) {
+        std::cerr << "can't open corpora\n";
+        return 1;
+    }
+    int null_fd = open(null_device, O_WRONLY);
+    Bench bench;
+
+    // kernels on pre-split verse lines
+    auto itx_lines = itx_verse_lines(itx_name);
+    double itx_bytes = static_cast<double>(total_size(itx_lines));
+    long sink = 0;
+    bench.add("itx_syllables", itx_bytes, best_of([&] {
+        for (auto & l: itx_lines) {
+            LinePattern p;
+            sink += encoded_syllables<ItransEncoding>(l, p);
+        }
+    }));
+    std::string unicode;
+    bench.add("itx_transliterate", itx_bytes, best_of([&] {
+        for (auto & l: itx_lines) {
+            to_unicode<ItransEncoding>(l, unicode);
+            sink += static_cast<long>(unicode.size());
+        }
+    }));
+    std::vector<std::string> iast_lines;
+    for (auto & l: itx_lines) {
+        to_unicode<ItransEncoding>(l, unicode);
+        iast_lines.push_back(unicode);
+    }
+    bench.add("utf8_syllables", static_cast<double>(total_size(iast_lines)), best_of([&] {
+        for (auto & l: iast_lines) {
+            LinePattern p;
+            sink += utf8_syllables(l, p);
+        }
+    }));
+    bench.add("utf8_syllable_count", static_cast<double>(total_size(iast_lines)), best_of([&] {
+        for (auto & l: iast_lines) {
+            sink += utf8_syllable_count(l);
+        }
+    }));
+
+    LineCollector collector;
+    {
+        FILE *f = fopen(rtf_name, "rb");
+        RtfParser<LineCollector> p;
+        p.RtfParse(f);
+        fclose(f);
+        collector.lines.swap(p.GetOutputter().lines);
+    }
+    auto & rtf_lines = collector.lines;
+    double rtf_line_bytes = static_cast<double>(total_size(rtf_lines));
+    bench.add("balaram_syllables", rtf_line_bytes, best_of([&] {
+        for (auto & l: rtf_lines) {
+            LinePattern p;
+            sink += encoded_syllables<BalaramEncoding>(l, p);
+        }
+    }));
+    bench.add("balaram_transliterate", rtf_line_bytes, best_of([&] {
+        for (auto & l: rtf_lines) {
+            to_unicode<BalaramEncoding>(l, unicode);
+            sink += static_cast<long>(unicode.size());
+        }
+    }));
+    bench.add("meter_identify", itx_bytes, best_of([&] {
+        for (auto & l: itx_lines) {
+            LinePattern p;
+            encoded_syllables<ItransEncoding>(l, p);
+            sink += static_cast<long>(identify_meter(p)[0]);
+        }
+    }));
+
+    // tokenizer alone, then end-to-end with the report discarded
+    auto rtf_tokenize = [&] {
+        FILE *f = fopen(rtf_name, "rb");
+        RtfParser<NullOutputter> p;
+        p.RtfParse(f);
+        fclose(f);
+    };
+    auto rtf_end_to_end = [&] {
+        FILE *f = fopen(rtf_name, "rb");
+        RtfParser<SbSlokaCounter> p;
+        p.GetOutputter().set_output_fd(null_fd);
+        p.RtfParse(f);
+        p.GetOutputter().print_totals();
+        fclose(f);
+    };
+    auto itx_end_to_end = [&] {
+        std::ifstream f(itx_name);
+        SlokaCounter c;
+        c.set_output_fd(null_fd);
+        c.do_counting(f);
+    };
+    bench.add("rtf_tokenize", static_cast<double>(rtf_size), best_of(rtf_tokenize));
+    bench.add("rtf_end_to_end", static_cast<double>(rtf_size), best_of(rtf_end_to_end));
+    bench.add("itx_end_to_end", static_cast<double>(itx_size), best_of(itx_end_to_end));
+
+    // the same lines pulled through VerseStream
+    auto stream_all = [&](char const * name, VerseFormat format) {
+        FILE *f = fopen(name, "rb");
+        FileSource in(f);
+        VerseStream verses(in, format);
+        for (auto & line: verses) sink += line.syllables;
+        fclose(f);
+    };
+    bench.add("rtf_verse_stream", static_cast<double>(rtf_size), best_of([&] {
+        stream_all(rtf_name, VerseFormat::rtf);
+    }));
+    bench.add("itx_verse_stream", static_cast<double>(itx_size), best_of([&] {
+        stream_all(itx_name, VerseFormat::itx);
+    }));
+
+    bench.sample_stages(rtf_end_to_end);
+    bench.add_stages("rtf_stage_", static_cast<double>(rtf_size),
+        {Stage::tokenize, Stage::keyword, Stage::group, Stage::classify});
+    bench.sample_stages(itx_end_to_end);
+    bench.add_stages("itx_stage_", static_cast<double>(itx_size), {Stage::classify});
+
+    if (sink == 42) printf(" \n");  // keep the kernel loops from being optimized away
+
+    bool ok = true;
+#ifndef SB_NO_STATS
+    AllocationCheck itx_check, rtf_check;
+    run_stats.start();
+    {
+        std::ifstream f(itx_name);
+        SlokaCounter c;
+        c.set_output_fd(null_fd);
+        check_allocations(c, itx_check);
+        c.do_counting(f);
+    }
+    {
+        FILE *f = fopen(rtf_name, "rb");
+        RtfParser<SbSlokaCounter> p;
+        p.GetOutputter().set_output_fd(null_fd);
+        check_allocations(p.GetOutputter(), rtf_check);
+        p.RtfParse(f);
+        fclose(f);
+    }
+    run_stats.stop();
+    ok = itx_check.report("itx_line_allocations") & rtf_check.report("rtf_line_allocations");
+#endif
+
+    if (json_name && !bench.write_json(json_name)) {
+        std::cerr << "can't write " << json_name << '\n';
+        return 1;
+    }
+    if (baseline_name && !bench.compare(baseline_name, threshold)) {
+        return 1;
+    }
+    return ok ? 0 : 1;
+}
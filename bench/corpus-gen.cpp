@@ -0,0 +1,192 @@
+// Scaled synthetic corpora for the benchmarks.
+//
+//   corpus-gen itx <bhagpur.itx> <out.itx> <size MB>
+//   corpus-gen rtf <bhagpur.itx> <out.rtf> <size MB>
+//
+// itx: the source replicated with cantos renumbered for every copy
+// (the two-digit canto field wraps after 99, which the ITX counter
+// doesn't mind).
+// rtf: the same verses as a Balaram-font RTF in the layout of sb.rtf:
+// "SB c.c:" chapter headings, TEXT/TEXTS headings, verse lines with
+// diacritics as \'xx escapes, SYNONYMS in another font, nested groups
+// and a \pict in every chapter. Cantos keep counting up across copies
+// so the numbering checks in sb-sloka-counter stay happy.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+struct ItxLine {
+    int canto, chapter, text, line;
+    std::string verse;
+};
+
+static std::vector<ItxLine> read_itx(char const * name) {
+    std::ifstream f(name);
+    if (!f) {
+        std::cerr << "can't open " << name << '\n';
+        std::exit(1);
+    }
+    static std::regex r(R"RE((\d\d)(\d\d)(\d\d\d)(\d) (.*?)(?: *#|$))RE");
+    std::vector<ItxLine> lines;
+    std::string line;
+    std::smatch m;
+    while (std::getline(f, line)) {
+        if (std::regex_search(line, m, r)) {
+            lines.push_back(ItxLine{std::stoi(m.str(1)), std::stoi(m.str(2)),
+                                    std::stoi(m.str(3)), std::stoi(m.str(4)), m.str(5)});
+        }
+    }
+    return lines;
+}
+
+static int generate_itx(char const * src, char const * out, std::size_t size) {
+    std::ifstream f(src);
+    if (!f) {
+        std::cerr << "can't open " << src << '\n';
+        return 1;
+    }
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(f, line)) lines.push_back(line);
+
+    FILE *o = fopen(out, "wb");
+    if (!o) {
+        std::cerr << "can't write " << out << '\n';
+        return 1;
+    }
+    std::size_t written = 0;
+    for (int copy = 0; written < size; ++copy) {
+        for (auto l: lines) {
+            if (l.size() > 8 && std::isdigit(static_cast<unsigned char>(l[0]))
+                    && std::isdigit(static_cast<unsigned char>(l[1]))) {
+                int canto = ((l[0] - '0') * 10 + (l[1] - '0') + 12 * copy - 1) % 99 + 1;
+                l[0] = static_cast<char>('0' + canto / 10);
+                l[1] = static_cast<char>('0' + canto % 10);
+            }
+            l += '\n';
+            fwrite(l.data(), 1, l.size(), o);
+            written += l.size();
+            if (written >= size) break;
+        }
+    }
+    return fclose(o) == 0 ? 0 : 1;
+}
+
+// ITRANS as used in bhagpur.itx to Balaram font bytes
+static std::string itx_to_balaram(std::string const & s) {
+    static const struct { char const * itx; char const * balaram; } map[] = {
+        {"R^I", "\xe8"}, {"R^i", "\xe5"}, {"L^i", "\xff"}, {"~N", "\xec"}, {"~n", "\xef"},
+        {"Sh", "\xf1"}, {"sh", "\xe7"}, {"Ch", "ch"}, {"ch", "c"}, {".a", "\x92"},
+        {"x", "k\xf1"}, {"GY", "j\xef"}, {"A", "\xe4"}, {"I", "\xe9"}, {"U", "\xfc"},
+        {"M", "\xe0"}, {"H", "\xf9"}, {"N", "\xeb"}, {"T", "\xf6"}, {"D", "\xf2"},
+    };
+    std::string b;
+    for (std::size_t i = 0; i < s.size();) {
+        bool found = false;
+        for (auto & m: map) {
+            auto n = std::strlen(m.itx);
+            if (s.compare(i, n, m.itx) == 0) {
+                b += m.balaram;
+                i += n;
+                found = true;
+                break;
+            }
+        }
+        if (!found) b += s[i++];
+    }
+    return b;
+}
+
+static std::string rtf_escape(std::string const & s) {
+    static char const hex[] = "0123456789abcdef";
+    std::string e;
+    for (char c: s) {
+        auto u = static_cast<unsigned char>(c);
+        if (u >= 0x80) {
+            e += "\\'";
+            e += hex[u >> 4];
+            e += hex[u & 0xf];
+        } else {
+            e += c;
+        }
+    }
+    return e;
+}
+
+static int generate_rtf(char const * src, char const * out, std::size_t size) {
+    auto lines = read_itx(src);
+    FILE *o = fopen(out, "wb");
+    if (!o) {
+        std::cerr << "can't write " << out << '\n';
+        return 1;
+    }
+    std::size_t written = 0;
+    auto put = [&](std::string const & s) {
+        fwrite(s.data(), 1, s.size(), o);
+        written += s.size();
+    };
+    std::string pict(2048, '0');
+    for (std::size_t i = 0; i < pict.size(); ++i) pict[i] = "0123456789abcdef"[(i * 7) % 16];
+
+    put("{\\rtf1\\ansi\\deff0{\\fonttbl{\\f0\\fnil Balaram;}{\\f1\\froman Times New Roman;}}\n"
+        "{\\colortbl;\\red0\\green0\\blue0;}{\\info{\\title Srimad-Bhagavatam}{\\author x}}\n"
+        "\\paperw12240\\paperh15840\\margl1800\\margr1800\n");
+    bool done = false;
+    for (int copy = 0; !done; ++copy) {
+        int canto = 0, chapter = 0, text = 0;
+        bool in_verse = false;
+        for (auto & l: lines) {
+            if (l.canto == 12 && l.chapter == 13 && l.text > 23) continue;
+            if (l.canto != canto || l.chapter != chapter) {
+                if (in_verse) put("\\par\\pard\\plain\\f0 SYNONYMS\\par\n");
+                if (written >= size) {
+                    done = true;
+                    break;
+                }
+                canto = l.canto;
+                chapter = l.chapter;
+                text = 0;
+                in_verse = false;
+                put("\\pard\\plain\\qc\\f0\\fs28 SB " + std::to_string(canto + 12 * copy) + "."
+                    + std::to_string(chapter) + ": {\\b\\i CHAPTER " + std::to_string(chapter)
+                    + "}\\par\n{\\*\\shppict{\\pict\\pngblip\\picw100\\pich100 " + pict + "}}\\par\n");
+            }
+            if (l.text < text) continue;
+            if (l.text != text) {
+                if (in_verse) {
+                    put("\\par\\pard\\plain\\f0 SYNONYMS\\par\n{\\f1\\i synonyms}{\\f1 \\endash  "
+                        "translation {\\b of} this verse}\\par\n");
+                }
+                put(l.text == text + 1
+                    ? "\\pard\\plain\\qc\\f0{\\b TEXT " + std::to_string(l.text) + "}\\par\n"
+                    : "\\pard\\plain\\qc\\f0{\\b TEXTS " + std::to_string(text + 1) + "\\'96"
+                        + std::to_string(l.text) + "}\\par\n");
+                text = l.text;
+                in_verse = true;
+            }
+            put("{\\i " + rtf_escape(itx_to_balaram(l.verse)) + "}\\par\n");
+        }
+        if (!done && in_verse) put("\\par\\pard\\plain\\f0 SYNONYMS\\par\n");
+        if (written >= size) done = true;
+    }
+    put("}\n");
+    return fclose(o) == 0 ? 0 : 1;
+}
+
+int main(int argc, char * argv[]) {
+    if (argc != 5) {
+        std::cerr << "usage: corpus-gen itx|rtf <bhagpur.itx> <output> <size MB>\n";
+        return 1;
+    }
+    auto size = static_cast<std::size_t>(std::atol(argv[4])) << 20;
+    if (std::strcmp(argv[1], "itx") == 0) return generate_itx(argv[2], argv[3], size);
+    if (std::strcmp(argv[1], "rtf") == 0) return generate_rtf(argv[2], argv[3], size);
+    std::cerr << "unknown corpus type " << argv[1] << '\n';
+    return 1;
+}
@@ -0,0 +1,115 @@
+#ifndef binary_file_h
+#define binary_file_h
+
+// What the binary formats (verse-columns.h, verse-index.h) share: writing
+// sections at 8-byte aligned offsets, and mapping a whole file read-only so
+// that readers can point straight into it.
+
+#include <cstdint>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+inline std::uint64_t binary_align(std::uint64_t pos) {
+    return (pos + 7) & ~std::uint64_t(7);
+}
+
+inline bool binary_put(FILE *f, void const * data, std::size_t size) {
+    return size == 0 || fwrite(data, 1, size, f) == size;
+}
+
+// pad up to the section start, then write the section
+inline bool binary_put_section(FILE *f, std::uint64_t offset, void const * data, std::size_t size) {
+    static char const zeros[8] = {};
+    long pos = ftell(f);
+    if (pos < 0) return false;
+    auto pad = static_cast<std::size_t>(offset - static_cast<std::uint64_t>(pos));
+    return pad < sizeof(zeros) && binary_put(f, zeros, pad) && binary_put(f, data, size);
+}
+
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    ~MappedFile() {
+        unmap();
+    }
+
+    MappedFile(MappedFile const &) = delete;
+    MappedFile & operator=(MappedFile const &) = delete;
+
+    char const * data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+    // count items of width bytes at offset lie inside the file; written so
+    // that corrupt values can't overflow
+    bool holds(std::uint64_t offset, std::uint64_t count, std::uint64_t width) const {
+        return offset <= size_ && count <= (size_ - offset) / width;
+    }
+
+#ifdef _WIN32
+    // nullptr, or why the file can't be mapped
+    char const * map(char const * path) {
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return "can't open file";
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size)) {
+            CloseHandle(file);
+            return "can't get file size";
+        }
+        size_ = static_cast<std::size_t>(file_size.QuadPart);
+        mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (!mapping_) return "can't map file";
+        data_ = static_cast<char const *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+        if (!data_) return "can't map file";
+        return nullptr;
+    }
+
+    void unmap() {
+        if (data_) UnmapViewOfFile(data_);
+        if (mapping_) CloseHandle(mapping_);
+        data_ = nullptr;
+        mapping_ = nullptr;
+    }
+#else
+    // nullptr, or why the file can't be mapped
+    char const * map(char const * path) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return "can't open file";
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return "can't stat file";
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        void * p = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) return "can't map file";
+        data_ = static_cast<char const *>(p);
+        return nullptr;
+    }
+
+    void unmap() {
+        if (data_) munmap(const_cast<char *>(data_), size_);
+        data_ = nullptr;
+    }
+#endif
+
+private:
+    char const * data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    HANDLE mapping_ = nullptr;
+#endif
+};
+
+#endif
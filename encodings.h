@@ -0,0 +1,382 @@
+#ifndef encodings_h
+#define encodings_h
+
+// The byte encodings of verse text: Balaram font text from sb.rtf and
+// ITRANS from bhagpur.itx. Each is a policy class of constexpr functions
+// saying what a byte is (letter), how it is written in Unicode (unicode),
+// what the bytes that depend on the ones after them amount to (digraph,
+// unicode_digraph) and how speakers' lines end (uvaca_suffixes). The
+// kernels below are templates over the policy; the per-byte functions are
+// turned into 256-entry tables at compile time, so each encoding gets its
+// own kernel with the tables inlined and nothing decided at run time.
+// UTF-8 text has its own kernel in utf8-syllables.h and is plugged in as
+// Utf8Encoding.
+
+#include <cstddef>
+#include <string>
+
+#include "meter.h"
+#include "stats.h"
+#include "utf8-syllables.h"
+
+// What a byte does to the syllable count.
+enum class ByteLetter : unsigned char {
+    other,
+    consonant,
+    aspirable,          // consonant that takes a following h as aspiration (kh, ṭh...)
+    h,
+    x,                  // kṣ in one letter
+    a,                  // a, or the start of ai/au
+    short_vowel,
+    long_vowel,
+    heavy,              // anusvara, visarga
+    digraph,            // depends on the bytes after it
+};
+
+// How a byte is written in Unicode.
+struct UnicodeByte {
+    char const * text;  // nullptr to copy the byte as it is
+    unsigned char size;
+    bool digraph;       // depends on the bytes after it
+};
+
+constexpr UnicodeByte copy_byte() {
+    return UnicodeByte{nullptr, 0, false};
+}
+
+template <std::size_t N>
+constexpr UnicodeByte unicode_text(char const (&text)[N]) {
+    return UnicodeByte{text, static_cast<unsigned char>(N - 1), false};
+}
+
+constexpr UnicodeByte digraph_byte() {
+    return UnicodeByte{nullptr, 0, true};
+}
+
+// true if c is one of the bytes of set
+constexpr bool byte_in(char const * set, unsigned c) {
+    return *set && (static_cast<unsigned char>(*set) == c || byte_in(set + 1, c));
+}
+
+struct UvacaSuffixes {
+    char const * at[4];     // up to the first nullptr
+};
+
+// sb.rtf's text in the Balaram font: ASCII plus Latin-1 bytes for the
+// letters with diacritics.
+struct BalaramEncoding {
+    static constexpr ByteLetter letter(unsigned c) {
+        return c == 'a' ? ByteLetter::a
+            : c == 'i' || c == 'u' || c == 0xe5 || c == 0xff ? ByteLetter::short_vowel     // ṛ ḷ
+            : byte_in("eo\xe4\xe9\xfc\xe8", c) ? ByteLetter::long_vowel                     // ā ī ū ṝ
+            : c == 0xe0 || c == 0xf9 ? ByteLetter::heavy                                    // ṁ ḥ
+            : c == 'h' ? ByteLetter::h
+            : byte_in("kgcjtdpb\xf6\xf2", c) ? ByteLetter::aspirable                        // ṭ ḍ
+            : byte_in("\xe7\xf1\xeb\xec\xef\xfb", c) ? ByteLetter::consonant                // ś ṣ ṇ ṅ ñ ḻ
+            // the other ASCII letters, capital vowels included
+            : (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ? ByteLetter::consonant
+            : ByteLetter::other;
+    }
+
+    static constexpr UnicodeByte unicode(unsigned c) {
+        return c == 0x92 ? unicode_text("'")
+            : c == 0x97 ? unicode_text("—")
+            : c == 0xe0 ? unicode_text("ṁ")
+            : c == 0xe4 ? unicode_text("ā")
+            : c == 0xe5 ? unicode_text("ṛ")
+            : c == 0xe7 ? unicode_text("ś")
+            : c == 0xe8 ? unicode_text("ṝ")
+            : c == 0xe9 ? unicode_text("ī")
+            : c == 0xeb ? unicode_text("ṇ")
+            : c == 0xec ? unicode_text("ṅ")
+            : c == 0xef ? unicode_text("ñ")
+            : c == 0xf1 ? unicode_text("ṣ")
+            : c == 0xf2 ? unicode_text("ḍ")
+            : c == 0xf6 ? unicode_text("ṭ")
+            : c == 0xf9 ? unicode_text("ḥ")
+            : c == 0xfb ? unicode_text("ḻ")
+            : c == 0xfc ? unicode_text("ū")
+            : c == 0xff ? unicode_text("ḷ")
+            : copy_byte();
+    }
+
+    static ByteLetter digraph(std::string const &, std::size_t &) {
+        return ByteLetter::other;
+    }
+
+    static void unicode_digraph(std::string const &, std::size_t &, std::string &) {}
+
+    static constexpr UvacaSuffixes uvaca_suffixes() {
+        return UvacaSuffixes{{
+            "ov\xe4" "ca",      // for rajovaaca, brahmovaaca, etc.
+            " uv\xe4" "ca",     // for generic singular "xxx uvaaca"
+            " \xfc" "cu\xf9",   // for generic plural "xxx uucuH"
+            nullptr,
+        }};
+    }
+};
+
+// bhagpur.itx's ITRANS: capitals and digraphs (sh, R^i, ~n...) in ASCII.
+struct ItransEncoding {
+    static constexpr ByteLetter letter(unsigned c) {
+        return c == 'a' ? ByteLetter::a
+            : c == 'i' || c == 'u' ? ByteLetter::short_vowel
+            : byte_in("AIUeo", c) ? ByteLetter::long_vowel
+            : c == 'M' || c == 'H' ? ByteLetter::heavy
+            : c == 'h' ? ByteLetter::h
+            : c == 'x' ? ByteLetter::x
+            : byte_in("RL.", c) ? ByteLetter::digraph
+            : byte_in("kgcCjTDtdpbsS", c) ? ByteLetter::aspirable
+            : byte_in("fGJlmnNqrvwyYz", c) ? ByteLetter::consonant
+            : ByteLetter::other;
+    }
+
+    static constexpr UnicodeByte unicode(unsigned c) {
+        return c == 'M' ? unicode_text("ṁ")
+            : c == 'A' ? unicode_text("ā")
+            : c == 'I' ? unicode_text("ī")
+            : c == 'N' ? unicode_text("ṇ")
+            : c == 'D' ? unicode_text("ḍ")
+            : c == 'T' ? unicode_text("ṭ")
+            : c == 'H' ? unicode_text("ḥ")
+            : c == 'U' ? unicode_text("ū")
+            : byte_in("RLS~s.cC", c) ? digraph_byte()
+            : copy_byte();
+    }
+
+    // R^i, L^i (vowels, as are Ri and RI) and .a (avagraha) at s[i]; i is
+    // left on the last byte used
+    static ByteLetter digraph(std::string const & s, std::size_t & i) {
+        std::size_t size = s.size();
+        char next = i + 1 < size ? s[i + 1] : '\0';
+        if (s[i] == '.') {
+            if (next == 'a') i += 1;
+            return ByteLetter::other;
+        }
+        if (next == 'i' || next == 'I') {
+            i += 2;
+            return next == 'I' ? ByteLetter::long_vowel : ByteLetter::short_vowel;
+        }
+        return next == '^' ? ByteLetter::other : ByteLetter::consonant;
+    }
+
+    static void unicode_digraph(std::string const & s, std::size_t & i, std::string & u) {
+        std::size_t size = s.size();
+        char next = i + 1 < size ? s[i + 1] : '\0';
+        char after = i + 2 < size ? s[i + 2] : '\0';
+        switch (s[i]) {
+            case 'R':
+                if (next == '^' && after == 'i') {
+                    i += 2;
+                    u += "ṛ";
+                } else if (next == '^' && after == 'I') {
+                    i += 2;
+                    u += "ṝ";
+                }
+                break;
+            case 'L':
+                if (next == '^' && after == 'i') {
+                    i += 2;
+                    u += "ḷ";
+                }
+                break;
+            case 'S':
+                if (next == 'h') {
+                    i += 1;
+                    u += "ś";
+                }
+                break;
+            case '~':
+                if (next == 'n') {
+                    i += 1;
+                    u += "ñ";
+                } else if (next == 'N') {
+                    i += 1;
+                    u += "ṅ";
+                }
+                break;
+            case 's':
+                if (next == 'h') {
+                    i += 1;
+                    u += "ṣ";
+                } else {
+                    u += 's';
+                }
+                break;
+            case '.':
+                if (next == 'a') {
+                    i += 1;
+                    u += " '";
+                }
+                break;
+            case 'c':
+                if (next == 'h') {
+                    i += 1;
+                    u += 'c';
+                }
+                break;
+            case 'C':
+                if (next == 'h') {
+                    i += 1;
+                    u += "ch";
+                }
+                break;
+        }
+    }
+
+    static constexpr UvacaSuffixes uvaca_suffixes() {
+        return UvacaSuffixes{{
+            "ovAcha",   // for rajovaaca, brahmovaaca, etc.
+            "uvAcha",   // for generic singular "xxx uvaaca"
+            "UchuH",    // for generic plural "xxx uucuH"
+            nullptr,
+        }};
+    }
+};
+
+// IAST or Devanagari in UTF-8, counted by utf8_syllables
+struct Utf8Encoding {};
+
+template <std::size_t... I> struct ByteIndices {};
+template <std::size_t N, std::size_t... I> struct MakeByteIndices : MakeByteIndices<N - 1, N - 1, I...> {};
+template <std::size_t... I> struct MakeByteIndices<0, I...> { typedef ByteIndices<I...> type; };
+
+template <class T>
+struct ByteTable {
+    T at[256];
+};
+
+// An encoding's per-byte functions as tables, filled in at compile time.
+template <class Encoding>
+struct EncodingTables {
+    template <std::size_t... I>
+    static constexpr ByteTable<ByteLetter> make_letters(ByteIndices<I...>) {
+        return ByteTable<ByteLetter>{{Encoding::letter(I)...}};
+    }
+
+    template <std::size_t... I>
+    static constexpr ByteTable<UnicodeByte> make_unicode(ByteIndices<I...>) {
+        return ByteTable<UnicodeByte>{{Encoding::unicode(I)...}};
+    }
+
+    static constexpr ByteTable<ByteLetter> letters = make_letters(MakeByteIndices<256>::type());
+    static constexpr ByteTable<UnicodeByte> unicode = make_unicode(MakeByteIndices<256>::type());
+};
+
+template <class Encoding>
+constexpr ByteTable<ByteLetter> EncodingTables<Encoding>::letters;
+template <class Encoding>
+constexpr ByteTable<UnicodeByte> EncodingTables<Encoding>::unicode;
+
+// Counts syllables and classifies each one as light or heavy:
+// heavy if the vowel is long or if it is followed by anusvara,
+// visarga or two or more consonants (across word boundaries).
+template <class Encoding>
+int encoded_syllables(std::string const & s, LinePattern & pattern) {
+    StatsStage stage(Stage::syllables);
+    ByteLetter const * letters = EncodingTables<Encoding>::letters.at;
+    int syllables_count = 0;
+    int consonants = 0; // consonants since the last vowel
+    auto vowel = [&](bool is_long) {
+        if (consonants >= 2) pattern.make_last_heavy();
+        consonants = 0;
+        pattern.add(is_long);
+        ++syllables_count;
+    };
+    auto size = s.size();
+    for (std::size_t i = 0; i < size; ++i) {
+        ByteLetter l = letters[static_cast<unsigned char>(s[i])];
+        if (l == ByteLetter::digraph) l = Encoding::digraph(s, i);
+        switch (l) {
+            case ByteLetter::long_vowel:
+                vowel(true);
+                break;
+            case ByteLetter::short_vowel:
+                vowel(false);
+                break;
+            case ByteLetter::a:
+                if (i+1 < size && (s[i+1] == 'i' || s[i+1] == 'u')) {
+                    ++i;
+                    vowel(true);
+                } else {
+                    vowel(false);
+                }
+                break;
+            case ByteLetter::heavy:
+                pattern.make_last_heavy();
+                break;
+            case ByteLetter::consonant:
+            case ByteLetter::aspirable:
+                ++consonants;
+                break;
+            case ByteLetter::x:
+                consonants += 2;
+                break;
+            case ByteLetter::h:
+                // the h of kh, ṭh... is aspiration, not a separate consonant
+                if (i == 0 || letters[static_cast<unsigned char>(s[i-1])] != ByteLetter::aspirable) {
+                    ++consonants;
+                }
+                break;
+            case ByteLetter::other:
+            case ByteLetter::digraph:
+                break;
+        }
+    }
+    if (consonants >= 2) pattern.make_last_heavy();
+    return syllables_count;
+}
+
+template <>
+inline int encoded_syllables<Utf8Encoding>(std::string const & s, LinePattern & pattern) {
+    return utf8_syllables(s, pattern);
+}
+
+// encoded_syllables for when the light/heavy pattern isn't wanted
+template <class Encoding>
+int encoded_syllable_count(std::string const & s) {
+    LinePattern pattern;
+    return encoded_syllables<Encoding>(s, pattern);
+}
+
+template <>
+inline int encoded_syllable_count<Utf8Encoding>(std::string const & s) {
+    return utf8_syllable_count(s);
+}
+
+// s in Unicode (UTF-8) into u, reusing its capacity
+template <class Encoding>
+void to_unicode(std::string const & s, std::string & u) {
+    StatsStage stage(Stage::transliterate);
+    UnicodeByte const * unicode = EncodingTables<Encoding>::unicode.at;
+    u.clear();
+    auto size = s.size();
+    for (std::size_t i = 0; i < size; ++i) {
+        UnicodeByte const & b = unicode[static_cast<unsigned char>(s[i])];
+        if (b.text) {
+            u.append(b.text, b.size);
+        } else if (b.digraph) {
+            Encoding::unicode_digraph(s, i, u);
+        } else {
+            u += s[i];
+        }
+    }
+}
+
+template <>
+inline void to_unicode<Utf8Encoding>(std::string const & s, std::string & u) {
+    u.assign(s);
+}
+
+// true if this is "... uvaaca" line
+template <class Encoding>
+bool is_uvaca(std::string const & line) {
+    auto suffixes = Encoding::uvaca_suffixes();
+    for (char const * const * p = suffixes.at; *p; ++p) {
+        std::size_t size = std::char_traits<char>::length(*p);
+        if (line.size() >= size && line.compare(line.size() - size, size, *p) == 0) return true;
+    }
+    return false;
+}
+
+#endif
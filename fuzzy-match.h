@@ -0,0 +1,60 @@
+#ifndef fuzzy_match_h
+#define fuzzy_match_h
+
+// Approximate substring matching with Myers' bit-parallel algorithm
+// (Hyyrö's formulation): one column of the edit-distance matrix per text
+// byte, the whole column in a 64-bit word, so patterns are limited to 64
+// bytes. Distances are in bytes, which for folded IAST text are letters.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MyersMatcher {
+public:
+    static const std::size_t max_pattern = 64;
+
+    // pattern must be 1 to max_pattern bytes
+    explicit MyersMatcher(std::string const & pattern) : size(static_cast<int>(pattern.size())) {
+        for (std::size_t i = 0; i < pattern.size(); ++i) {
+            peq[static_cast<unsigned char>(pattern[i])] |= std::uint64_t(1) << i;
+        }
+        last = std::uint64_t(1) << (pattern.size() - 1);
+    }
+
+    // Smallest edit distance between the pattern and any substring of
+    // [p, end); best_end is the offset just past the first substring with it.
+    int best(char const * p, char const * end, std::size_t & best_end) const {
+        std::uint64_t pv = ~std::uint64_t(0);
+        std::uint64_t mv = 0;
+        int score = size;
+        int best_score = size;
+        best_end = 0;
+        for (char const * start = p; p < end; ++p) {
+            std::uint64_t eq = peq[static_cast<unsigned char>(*p)];
+            std::uint64_t xv = eq | mv;
+            std::uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+            std::uint64_t ph = mv | ~(xh | pv);
+            std::uint64_t mh = pv & xh;
+            if (ph & last) ++score;
+            else if (mh & last) --score;
+            // no carry into the top row: a match may start anywhere
+            ph <<= 1;
+            mh <<= 1;
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
+            if (score < best_score) {
+                best_score = score;
+                best_end = static_cast<std::size_t>(p - start) + 1;
+            }
+        }
+        return best_score;
+    }
+
+private:
+    std::uint64_t peq[256] = {};
+    std::uint64_t last;
+    int size;
+};
+
+#endif
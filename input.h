@@ -0,0 +1,358 @@
+#ifndef input_h
+#define input_h
+
+// Input read in large chunks. gzip input (and zstd when built with SB_ZSTD)
+// is recognized by its magic bytes and decompressed on a separate thread
+// into a small ring of buffers, so decompression overlaps with parsing and
+// memory stays bounded by the ring.
+
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef SB_ZLIB
+#include <zlib.h>
+#endif
+#ifdef SB_ZSTD
+#include <zstd.h>
+#endif
+
+class ByteSource {
+public:
+    virtual ~ByteSource() = default;
+
+    // Next chunk of input, valid until the next call; false at the end of
+    // the input or on an error.
+    virtual bool next(char *& data, std::size_t & size) = 0;
+
+    // why the input ended early; empty if it didn't
+    std::string const & error() const { return error_; }
+
+protected:
+    std::string error_;
+};
+
+// Plain file, read in place.
+class FileSource : public ByteSource {
+public:
+    explicit FileSource(FILE * fp, bool owned = false, std::size_t chunk = 256 * 1024)
+        : fp_(fp), owned_(owned), buf(chunk) {}
+
+    ~FileSource() {
+        if (owned_) fclose(fp_);
+    }
+
+    // stop after this many more bytes, for reading one chunk of a file
+    void set_limit(long bytes) {
+        limit = bytes;
+    }
+
+    bool next(char *& data, std::size_t & size) override {
+        std::size_t want = buf.size();
+        if (limit >= 0 && want > static_cast<std::size_t>(limit)) want = static_cast<std::size_t>(limit);
+        if (want == 0) return false;
+        size = fread(buf.data(), 1, want, fp_);
+        if (limit >= 0) limit -= static_cast<long>(size);
+        if (size == 0) {
+            if (ferror(fp_)) error_ = "read error";
+            return false;
+        }
+        data = buf.data();
+        return true;
+    }
+
+private:
+    FILE * fp_;
+    bool owned_;
+    std::vector<char> buf;
+    long limit = -1;
+};
+
+// Caller's buffer, read in place and handed out as a single chunk.
+class MemorySource : public ByteSource {
+public:
+    MemorySource(char const * data, std::size_t size) : data_(data), size_(size) {}
+
+    bool next(char *& data, std::size_t & size) override {
+        if (done || size_ == 0) return false;
+        done = true;
+        // readers never write through it; char * only because std::streambuf wants one
+        data = const_cast<char *>(data_);
+        size = size_;
+        return true;
+    }
+
+private:
+    char const * data_;
+    std::size_t size_;
+    bool done = false;
+};
+
+// Ring of buffers filled by a producer thread. The consumer holds one
+// buffer at a time and gives it back on its next call.
+class ThreadedSource : public ByteSource {
+public:
+    // fill(buffer, capacity, size) writes up to capacity bytes, sets size and
+    // returns false at the end of the input (size may still be nonzero);
+    // on errors it sets the message and returns false
+    typedef std::function<bool(char *, std::size_t, std::size_t &, std::string &)> Fill;
+
+    ThreadedSource(Fill fill, std::size_t buffers = 4, std::size_t buffer_size = 1 << 20)
+        : ring(buffers, std::vector<char>(buffer_size)), sizes(buffers) {
+        producer = std::thread([this, fill] { produce(fill); });
+    }
+
+    ~ThreadedSource() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            cancelled = true;
+        }
+        space.notify_all();
+        if (producer.joinable()) producer.join();
+    }
+
+    bool next(char *& data, std::size_t & size) override {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (holding) {
+            holding = false;
+            --filled;
+            read_pos = (read_pos + 1) % ring.size();
+            space.notify_one();
+        }
+        ready.wait(lock, [this] { return filled > 0 || done; });
+        if (filled == 0) {
+            error_ = producer_error;
+            return false;
+        }
+        holding = true;
+        data = ring[read_pos].data();
+        size = sizes[read_pos];
+        return true;
+    }
+
+private:
+    std::vector<std::vector<char>> ring;
+    std::vector<std::size_t> sizes;
+    std::mutex mutex;
+    std::condition_variable ready;      // a buffer was filled
+    std::condition_variable space;      // a buffer was given back
+    std::size_t filled = 0;             // buffers filled, including the one held
+    std::size_t read_pos = 0;
+    std::size_t write_pos = 0;
+    bool holding = false;
+    bool done = false;
+    bool cancelled = false;
+    std::string producer_error;
+    std::thread producer;
+
+    void produce(Fill const & fill) {
+        bool more = true;
+        std::string error;
+        while (more) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                space.wait(lock, [this] { return filled < ring.size() || cancelled; });
+                if (cancelled) return;
+            }
+            std::size_t size = 0;
+            more = fill(ring[write_pos].data(), ring[write_pos].size(), size, error);
+            if (size == 0) continue;
+            std::lock_guard<std::mutex> lock(mutex);
+            sizes[write_pos] = size;
+            write_pos = (write_pos + 1) % ring.size();
+            ++filled;
+            ready.notify_one();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        producer_error = error;
+        done = true;
+        ready.notify_one();
+    }
+};
+
+#ifdef SB_ZLIB
+// gzip (possibly several concatenated members) to a ThreadedSource fill
+class GzipFill {
+public:
+    explicit GzipFill(FILE * fp) : fp_(fp), in(256 * 1024) {
+        z.zalloc = Z_NULL;
+        z.zfree = Z_NULL;
+        z.opaque = Z_NULL;
+        z.next_in = Z_NULL;
+        z.avail_in = 0;
+        inflateInit2(&z, 15 + 16);
+    }
+
+    ~GzipFill() {
+        inflateEnd(&z);
+        fclose(fp_);
+    }
+
+    GzipFill(GzipFill const &) = delete;
+    GzipFill & operator=(GzipFill const &) = delete;
+
+    bool fill(char * out, std::size_t capacity, std::size_t & size, std::string & error) {
+        z.next_out = reinterpret_cast<Bytef *>(out);
+        z.avail_out = static_cast<uInt>(capacity);
+        while (z.avail_out > 0) {
+            if (z.avail_in == 0) {
+                std::size_t n = fread(in.data(), 1, in.size(), fp_);
+                if (n == 0) {
+                    size = capacity - z.avail_out;
+                    if (ferror(fp_)) error = "read error";
+                    else if (!at_member_end) error = "truncated gzip input";
+                    return false;
+                }
+                z.next_in = reinterpret_cast<Bytef *>(in.data());
+                z.avail_in = static_cast<uInt>(n);
+            }
+            int rc = inflate(&z, Z_NO_FLUSH);
+            at_member_end = (rc == Z_STREAM_END);
+            if (rc == Z_STREAM_END) {
+                inflateReset(&z);   // another member may follow
+            } else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+                size = capacity - z.avail_out;
+                error = std::string("gzip: ") + (z.msg ? z.msg : "corrupt input");
+                return false;
+            }
+        }
+        size = capacity;
+        return true;
+    }
+
+private:
+    FILE * fp_;
+    std::vector<char> in;
+    z_stream z;
+    bool at_member_end = false;
+};
+#endif
+
+#ifdef SB_ZSTD
+class ZstdFill {
+public:
+    explicit ZstdFill(FILE * fp) : fp_(fp), in(ZSTD_DStreamInSize()), stream(ZSTD_createDStream()) {
+        ZSTD_initDStream(stream);
+    }
+
+    ~ZstdFill() {
+        ZSTD_freeDStream(stream);
+        fclose(fp_);
+    }
+
+    ZstdFill(ZstdFill const &) = delete;
+    ZstdFill & operator=(ZstdFill const &) = delete;
+
+    bool fill(char * out, std::size_t capacity, std::size_t & size, std::string & error) {
+        ZSTD_outBuffer o = {out, capacity, 0};
+        while (o.pos < o.size) {
+            if (input.pos == input.size) {
+                std::size_t n = fread(in.data(), 1, in.size(), fp_);
+                if (n == 0) {
+                    size = o.pos;
+                    if (ferror(fp_)) error = "read error";
+                    else if (!at_frame_end) error = "truncated zstd input";
+                    return false;
+                }
+                input = ZSTD_inBuffer{in.data(), n, 0};
+            }
+            std::size_t rc = ZSTD_decompressStream(stream, &o, &input);
+            if (ZSTD_isError(rc)) {
+                size = o.pos;
+                error = std::string("zstd: ") + ZSTD_getErrorName(rc);
+                return false;
+            }
+            at_frame_end = (rc == 0);
+        }
+        size = o.pos;
+        return true;
+    }
+
+private:
+    FILE * fp_;
+    std::vector<char> in;
+    ZSTD_DStream * stream;
+    ZSTD_inBuffer input = {nullptr, 0, 0};
+    bool at_frame_end = true;
+};
+#endif
+
+// Opens path as plain, gzip or zstd input by its first bytes. Null, with
+// the reason in error, if the file can't be opened or read.
+inline std::unique_ptr<ByteSource> open_input(std::string const & path, std::string & error) {
+    FILE * fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        error = "can't open " + path;
+        return nullptr;
+    }
+    unsigned char magic[4] = {};
+    std::size_t n = fread(magic, 1, sizeof(magic), fp);
+    rewind(fp);
+    if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+#ifdef SB_ZLIB
+        auto gz = std::make_shared<GzipFill>(fp);
+        return std::unique_ptr<ByteSource>(new ThreadedSource(
+            [gz](char * out, std::size_t capacity, std::size_t & size, std::string & e) {
+                return gz->fill(out, capacity, size, e);
+            }));
+#else
+        fclose(fp);
+        error = path + " is gzip-compressed; built without zlib";
+        return nullptr;
+#endif
+    }
+    if (n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+#ifdef SB_ZSTD
+        auto zs = std::make_shared<ZstdFill>(fp);
+        return std::unique_ptr<ByteSource>(new ThreadedSource(
+            [zs](char * out, std::size_t capacity, std::size_t & size, std::string & e) {
+                return zs->fill(out, capacity, size, e);
+            }));
+#else
+        fclose(fp);
+        error = path + " is zstd-compressed; built without zstd";
+        return nullptr;
+#endif
+    }
+    return std::unique_ptr<ByteSource>(new FileSource(fp, true));
+}
+
+// Opens the first of path, path.gz and path.zst that exists.
+inline std::unique_ptr<ByteSource> open_input_or_compressed(std::string const & path,
+                                                            std::string & error) {
+    for (char const * suffix: {"", ".gz", ".zst"}) {
+        FILE * probe = fopen((path + suffix).c_str(), "rb");
+        if (probe) {
+            fclose(probe);
+            return open_input(path + suffix, error);
+        }
+    }
+    error = "can't open " + path;
+    return nullptr;
+}
+
+// std::istream adapter, for the line-based ITX reader.
+class SourceStreambuf : public std::streambuf {
+public:
+    explicit SourceStreambuf(ByteSource & source) : source_(source) {}
+
+protected:
+    int_type underflow() override {
+        char * data;
+        std::size_t size;
+        if (!source_.next(data, size)) return traits_type::eof();
+        setg(data, data, data + size);
+        return traits_type::to_int_type(*data);
+    }
+
+private:
+    ByteSource & source_;
+};
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef meter_h
+#define meter_h
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+// Light/heavy (laghu/guru) pattern of one line: bit i is set when
+// syllable i is heavy. Syllables beyond max_syllables are counted
+// but their weight is not recorded.
+struct LinePattern {
+    static const int max_syllables = 64;
+    std::uint64_t guru = 0;
+    int count = 0;
+
+    void add(bool heavy) {
+        if (heavy && count < max_syllables) {
+            guru |= std::uint64_t(1) << count;
+        }
+        ++count;
+    }
+
+    // previous syllable turned out to be heavy by position
+    // (followed by anusvara, visarga or a consonant cluster)
+    void make_last_heavy() {
+        if (count > 0 && count <= max_syllables) {
+            guru |= std::uint64_t(1) << (count - 1);
+        }
+    }
+
+    // "G"/"L" per syllable
+    template <class Out>
+    void append_to(Out & out) const {
+        for (int i = 0; i < count && i < max_syllables; ++i) {
+            out.append((guru >> i) & 1 ? 'G' : 'L');
+        }
+    }
+
+    std::string to_string() const {
+        std::string s;
+        for (int i = 0; i < count && i < max_syllables; ++i) {
+            s += (guru >> i) & 1 ? 'G' : 'L';
+        }
+        return s;
+    }
+};
+
+// Meters are identified by pada: a line holds either one pada (long meters)
+// or two (anushtubh half-verse, most trishtubh and jagati lines). The last
+// syllable of a pada is anceps, so it is always treated as heavy.
+class MeterTable {
+public:
+    MeterTable() {
+        // every 8-syllable pattern is some form of anushtubh (pathya or vipula)
+        for (std::uint64_t mask = 0; mask < 256; ++mask) {
+            table[key(8, mask)] = "anuṣṭubh";
+        }
+        add("GGLGGLLGLGG", "indravajrā");
+        add("LGLGGLLGLGG", "upendravajrā");
+        add("GGGGGLGGLGG", "śālinī");
+        add("GLGLLLGLGLG", "rathoddhatā");
+        add("GLGLLLGLLGG", "svāgatā");
+        add("LGLGGLLGLGLG", "vaṁśastha");
+        add("GGLGGLLGLGLG", "indravaṁśā");
+        add("LLLGLLGLLGLG", "drutavilambita");
+        add("LGGLGGLGGLGG", "bhujaṅgaprayāta");
+        add("LLGLLGLLGLLG", "toṭaka");
+        add("GGGLLLLGLGLGG", "praharṣiṇī");
+        add("LGLGLLLLGLGLG", "rucirā");
+        add("LLGLGLLLGLGLG", "mañjubhāṣiṇī");
+        add("GGLGLLLGLLGLGG", "vasantatilakā");
+        add("LLLLLLGGGLGGLGG", "mālinī");
+        add("LGLLLGLGLLLGLGGLG", "pṛthvī");
+        add("LGGGGGLLLLLGGLLLG", "śikhariṇī");
+        add("GGGGLLLLLGGLGGLGG", "mandākrāntā");
+        add("LLLLLGGGGGLGLLGLG", "hariṇī");
+        add("GGGLLGLGLLLGGGLGGLG", "śārdūlavikrīḍita");
+        add("GGGGLGGLLLLLLGGLGGLGG", "sragdharā");
+    }
+
+    char const * identify(LinePattern const & p) const {
+        int n = p.count;
+        if (n == 0) return "";
+        if (n <= max_pada) {
+            if (char const * name = find(n, p.guru)) return name;
+        }
+        // two padas; odd lengths are trishtubh and jagati padas mixed
+        if (n - n / 2 <= max_pada) {
+            for (int split = n / 2; split <= n - n / 2; ++split) {
+                int rest = n - split;
+                std::uint64_t first_mask = p.guru & ((std::uint64_t(1) << split) - 1);
+                std::uint64_t second_mask = (p.guru >> split) & ((std::uint64_t(1) << rest) - 1);
+                char const * first = find(split, first_mask);
+                char const * second = find(rest, second_mask);
+                if (first && first == second) return first;
+                if (first && second) return "upajāti";
+            }
+            if (n % 2 == 0) return family(n / 2);
+        }
+        return family(n);
+    }
+
+private:
+    static const int max_pada = 32;
+    std::unordered_map<std::uint64_t, char const *> table;
+
+    static std::uint64_t key(int n, std::uint64_t mask) {
+        mask |= std::uint64_t(1) << (n - 1);
+        return (std::uint64_t(n) << max_pada) | mask;
+    }
+
+    void add(char const * gl, char const * name) {
+        std::uint64_t mask = 0;
+        int n = 0;
+        for (; gl[n]; ++n) {
+            if (gl[n] == 'G') mask |= std::uint64_t(1) << n;
+        }
+        table[key(n, mask)] = name;
+    }
+
+    char const * find(int n, std::uint64_t mask) const {
+        auto it = table.find(key(n, mask));
+        return it == table.end() ? nullptr : it->second;
+    }
+
+    static char const * family(int n) {
+        switch (n) {
+            case 8: return "anuṣṭubh";
+            case 11: return "triṣṭubh";
+            case 12: return "jagatī";
+            default: return "other";
+        }
+    }
+};
+
+// Orders the names identify_meter() returns as std::string would, so they
+// can be counted without building a string per line.
+struct MeterNameLess {
+    bool operator()(char const * a, char const * b) const {
+        return std::strcmp(a, b) < 0;
+    }
+};
+
+inline char const * identify_meter(LinePattern const & p) {
+    static const MeterTable table;
+    return table.identify(p);
+}
+
+#endif
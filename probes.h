@@ -0,0 +1,42 @@
+#ifndef probes_h
+#define probes_h
+
+// USDT (SystemTap-style) static probes for perf, bpftrace and stap, e.g.
+//
+//   bpftrace -e 'usdt:./sb-sloka-counter:sb:chapter { printf("%d.%d\n", arg0, arg1); }'
+//
+// Each probe is a single nop plus an ELF note saying where its arguments
+// are, so an unattached probe only costs keeping the arguments at hand.
+// Built only with SB_PROBES (CMake option of the same name, on by default
+// when <sys/sdt.h> is available); otherwise the arguments aren't evaluated.
+//
+// RtfParser:
+//   group_push(depth, offset)        group_pop(depth, offset)
+//   keyword(name, param, offset)     flush(chars, offset)
+// Counters:
+//   line_start(line, offset)         line_end(verse_id, syllables)
+//   verse_start(verse_id)            chapter(canto, chapter)
+//   output_flush(bytes)
+//
+// Offsets are input bytes, except the RTF counter's line_start, which only
+// sees the extracted text and gives the offset into that. Verse ids are
+// packed as in verse.h; line_end has 0 for lines outside verses.
+
+#ifdef SB_PROBES
+
+#include <sys/sdt.h>
+
+#define SB_PROBE1(name, a) DTRACE_PROBE1(sb, name, a)
+#define SB_PROBE2(name, a, b) DTRACE_PROBE2(sb, name, a, b)
+#define SB_PROBE3(name, a, b, c) DTRACE_PROBE3(sb, name, a, b, c)
+
+#else
+
+// sizeof keeps locals that only feed probes from being "unused"
+#define SB_PROBE1(name, a) do { (void)sizeof(a); } while (0)
+#define SB_PROBE2(name, a, b) do { (void)sizeof(a); (void)sizeof(b); } while (0)
+#define SB_PROBE3(name, a, b, c) do { (void)sizeof(a); (void)sizeof(b); (void)sizeof(c); } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef repeats_h
+#define repeats_h
+
+// Repeated and nearly repeated verse lines (--repeats, --unique-totals),
+// fed by the counters' line sink.
+//
+// Lines are compared in the folded form of verse-index.h, so spacing and
+// sandhi splits don't hide a repeat. Each line gets a 64-bit hash; equal
+// hashes make a group of exact repeats. For near repeats every window of
+// window_letters folded letters is hashed with a rolling (polynomial) hash
+// and about one window in four is kept as a fingerprint, chosen by the
+// hash so that equal windows are always kept alike. A line is a near
+// repeat of an earlier line that holds at least half of the fingerprints of
+// the shorter of the two. Fingerprints map to the first line that had
+// them, and lines are joined into groups with union-find, so the work is
+// linear in the input. Memory is a small record per line, the line text,
+// and the fingerprint table, which stops growing at max_fingerprints.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "verse-index.h"
+#include "verse.h"
+
+class RepeatFinder {
+public:
+    static const std::size_t window_letters = 12;
+    static const std::size_t max_fingerprints = 1 << 22;
+
+    void add_line(std::uint32_t id, int syllables, bool uvaca, std::string const & text) {
+        auto line = static_cast<std::uint32_t>(lines.size());
+        folded.clear();
+        fold_for_search(text.data(), text.data() + text.size(), folded);
+        fingerprints(folded, line_prints);
+
+        Line l{id, line, static_cast<std::uint32_t>(blob.size()), static_cast<std::uint32_t>(text.size()),
+               hash(folded), syllables, uvaca, static_cast<std::uint16_t>(line_prints.size())};
+        blob.append(text);
+        auto inserted = first_by_hash.emplace(l.hash, line);
+        if (!inserted.second) {
+            l.parent = inserted.first->second;
+        } else {
+            link_near(l, line, line_prints);
+        }
+        lines.push_back(l);
+    }
+
+    // Groups of exact repeats, "Nx: text: id, id...", then groups of near
+    // repeats, "~ N lines:" and "id, id...: text" per distinct line, in
+    // order of first occurrence.
+    void write(FILE * f) {
+        std::vector<std::vector<std::uint32_t>> exact(lines.size()), near(lines.size());
+        for (std::uint32_t i = 0; i < lines.size(); ++i) {
+            exact[first(i)].push_back(i);
+            near[root(i)].push_back(i);
+        }
+        std::size_t groups = 0, repeats = 0;
+        for (auto & g: exact) {
+            if (g.size() > 1) {
+                ++groups;
+                repeats += g.size() - 1;
+            }
+        }
+        fprintf(f, "repeated lines: %zu groups, %zu repeats\n", groups, repeats);
+        for (auto & g: exact) {
+            if (g.size() < 2) continue;
+            fprintf(f, "  %zux: %s: ", g.size(), text(g[0]).c_str());
+            write_ids(f, g);
+            fprintf(f, "\n");
+        }
+
+        groups = 0;
+        for (auto & g: near) {
+            if (g.size() > 1 && !all_same(g)) ++groups;
+        }
+        fprintf(f, "near-repeated lines: %zu groups\n", groups);
+        for (auto & g: near) {
+            if (g.size() < 2 || all_same(g)) continue;
+            fprintf(f, "  ~ %zu lines:\n", g.size());
+            for (auto i: g) {
+                if (first(i) != i) continue;
+                fprintf(f, "    ");
+                write_ids(f, exact[i]);
+                fprintf(f, ": %s\n", text(i).c_str());
+            }
+        }
+    }
+
+    // the corpus totals with every repeated line counted only at its first occurrence
+    void write_unique_totals(FILE * f) const {
+        long total = 0, total_no_uvaca = 0;
+        for (std::uint32_t i = 0; i < lines.size(); ++i) {
+            if (first(i) != i) continue;
+            total += lines[i].syllables;
+            if (!lines[i].uvaca) total_no_uvaca += lines[i].syllables;
+        }
+        fprintf(f, "total syllables (repeats once): %ld\n", total);
+        fprintf(f, "total syllables (no uvaaca, repeats once): %ld\n", total_no_uvaca);
+    }
+
+private:
+    struct Line {
+        std::uint32_t id;
+        std::uint32_t parent;       // union-find; an exact repeat points at its first occurrence
+        std::uint32_t text_offset;
+        std::uint32_t text_size;
+        std::uint64_t hash;
+        int syllables;
+        bool uvaca;
+        std::uint16_t prints;       // fingerprints kept
+    };
+
+    std::vector<Line> lines;
+    std::string blob;
+    std::unordered_map<std::uint64_t, std::uint32_t> first_by_hash;
+    std::unordered_map<std::uint64_t, std::uint32_t> first_by_print;
+    // per-line buffers, kept to reuse their capacity
+    std::string folded;
+    std::vector<std::uint64_t> line_prints;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> shared;
+
+    static const std::uint64_t base = 0x100000001b3ull;
+
+    static std::uint64_t hash(std::string const & s) {
+        std::uint64_t h = 0;
+        for (char c: s) h = h * base + static_cast<unsigned char>(c);
+        return h * 0x9e3779b97f4a7c15ull;
+    }
+
+    // the distinct kept window hashes of s
+    static void fingerprints(std::string const & s, std::vector<std::uint64_t> & prints) {
+        prints.clear();
+        if (s.size() < window_letters) return;
+        std::uint64_t top = 1;      // base^(window_letters - 1)
+        for (std::size_t i = 1; i < window_letters; ++i) top *= base;
+        std::uint64_t h = 0;
+        for (std::size_t i = 0; i < s.size(); ++i) {
+            if (i >= window_letters) h -= top * static_cast<unsigned char>(s[i - window_letters]);
+            h = h * base + static_cast<unsigned char>(s[i]);
+            if (i + 1 < window_letters) continue;
+            std::uint64_t mixed = h * 0x9e3779b97f4a7c15ull;
+            if (mixed >> 62 == 0) prints.push_back(mixed);
+        }
+        std::sort(prints.begin(), prints.end());
+        prints.erase(std::unique(prints.begin(), prints.end()), prints.end());
+    }
+
+    // joins l with the earlier line it shares most fingerprints with, if
+    // that is at least half of the shorter line's
+    void link_near(Line & l, std::uint32_t line, std::vector<std::uint64_t> const & prints) {
+        shared.clear();
+        for (auto p: prints) {
+            auto found = first_by_print.find(p);
+            if (found == first_by_print.end()) {
+                if (first_by_print.size() < max_fingerprints) first_by_print.emplace(p, line);
+                continue;
+            }
+            auto it = std::find_if(shared.begin(), shared.end(),
+                                   [&](std::pair<std::uint32_t, std::uint32_t> const & s) {
+                                       return s.first == found->second;
+                                   });
+            if (it == shared.end()) shared.emplace_back(found->second, 1);
+            else ++it->second;
+        }
+        auto best = std::max_element(shared.begin(), shared.end(),
+                                     [](std::pair<std::uint32_t, std::uint32_t> const & a,
+                                        std::pair<std::uint32_t, std::uint32_t> const & b) {
+                                         return a.second < b.second;
+                                     });
+        if (best == shared.end() || best->second < 2) return;
+        if (2 * best->second >= std::min<std::uint32_t>(l.prints, lines[best->first].prints)) {
+            l.parent = root(best->first);
+        }
+    }
+
+    std::uint32_t root(std::uint32_t i) {
+        while (lines[i].parent != i) {
+            lines[i].parent = lines[lines[i].parent].parent;
+            i = lines[i].parent;
+        }
+        return i;
+    }
+
+    // the first line with the same text as line i
+    std::uint32_t first(std::uint32_t i) const {
+        return first_by_hash.find(lines[i].hash)->second;
+    }
+
+    void write_ids(FILE * f, std::vector<std::uint32_t> const & group) const {
+        char const * sep = "";
+        for (auto i: group) {
+            fprintf(f, "%s%s", sep, verse_id_to_string(lines[i].id).c_str());
+            sep = ", ";
+        }
+    }
+
+    bool all_same(std::vector<std::uint32_t> const & group) const {
+        for (auto i: group) {
+            if (lines[i].hash != lines[group[0]].hash) return false;
+        }
+        return true;
+    }
+
+    std::string text(std::uint32_t i) const {
+        return blob.substr(lines[i].text_offset, lines[i].text_size);
+    }
+};
+
+#endif
@@ -0,0 +1,468 @@
+#ifndef report_writer_h
+#define report_writer_h
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "meter.h"
+#include "probes.h"
+#include "verse.h"
+
+// Output buffer written to a file descriptor in large blocks, bypassing
+// iostreams and locale-aware number formatting.
+class OutputBuffer {
+public:
+    explicit OutputBuffer(int fd = 1) : fd_(fd) {
+        buf.reserve(capacity);
+    }
+
+    void set_fd(int fd) {
+        flush();
+        fd_ = fd;
+    }
+
+    ~OutputBuffer() {
+        flush();
+    }
+
+    OutputBuffer(OutputBuffer const &) = delete;
+    OutputBuffer & operator=(OutputBuffer const &) = delete;
+
+    void append(char const * data, std::size_t size) {
+        if (buf.size() + size > capacity) flush();
+        buf.insert(buf.end(), data, data + size);
+    }
+
+    void append(char const * s) {
+        append(s, std::strlen(s));
+    }
+
+    void append(std::string const & s) {
+        append(s.data(), s.size());
+    }
+
+    void append(char c) {
+        if (buf.size() + 1 > capacity) flush();
+        buf.push_back(c);
+    }
+
+    void append_int(long long value) {
+        char digits[24];
+        char * end = digits + sizeof(digits);
+        char * p = end;
+        bool negative = value < 0;
+        auto u = negative ? 0 - static_cast<unsigned long long>(value)
+                          : static_cast<unsigned long long>(value);
+        do {
+            *--p = static_cast<char>('0' + u % 10);
+            u /= 10;
+        } while (u);
+        if (negative) *--p = '-';
+        append(p, static_cast<std::size_t>(end - p));
+    }
+
+    void flush() {
+        if (!buf.empty()) SB_PROBE1(output_flush, buf.size());
+        char const * p = buf.data();
+        std::size_t left = buf.size();
+        while (left > 0) {
+#ifdef _WIN32
+            int n = _write(fd_, p, static_cast<unsigned>(left));
+#else
+            auto n = ::write(fd_, p, left);
+            if (n < 0 && errno == EINTR) continue;
+#endif
+            if (n <= 0) {           // drop the rest; failed() tells
+                failed_ = true;
+                break;
+            }
+            p += n;
+            left -= static_cast<std::size_t>(n);
+        }
+        buf.clear();
+    }
+
+    // true once a write has failed
+    bool failed() const {
+        return failed_;
+    }
+
+private:
+    static const std::size_t capacity = 1 << 20;
+    int fd_;
+    bool failed_ = false;
+    std::vector<char> buf;
+};
+
+enum class ReportFormat { text, csv, ndjson };
+
+// "text" (default), "csv" or "ndjson"; false for anything else
+inline bool parse_format(std::string const & name, ReportFormat & format) {
+    if (name == "text") format = ReportFormat::text;
+    else if (name == "csv") format = ReportFormat::csv;
+    else if (name == "ndjson") format = ReportFormat::ndjson;
+    else return false;
+    return true;
+}
+
+// one verse line of the report
+struct ReportLine {
+    std::uint32_t id;
+    std::uint32_t last_id;          // == id unless this is a "TEXTS a-b" range
+    int syllables;
+    bool uvaca;
+    std::string const * text;       // transliterated
+    LinePattern const * pattern;    // null unless meters are shown
+    char const * meter;
+};
+
+// Formats per-line and per-chapter results. The text format is the
+// classic "1.1.1(19): text" / "chapter 01.01: N" output.
+class ReportWriter {
+public:
+    explicit ReportWriter(ReportFormat format = ReportFormat::text, int fd = 1)
+        : format_(format), out(fd) {}
+
+    void set_format(ReportFormat format) {
+        format_ = format;
+    }
+
+    void set_fd(int fd) {
+        out.set_fd(fd);
+    }
+
+    void line(ReportLine const & l) {
+        switch (format_) {
+        case ReportFormat::text:
+            verse_label(l);
+            out.append('(');
+            out.append_int(l.syllables);
+            if (l.uvaca) out.append('\'');
+            out.append("): ");
+            out.append(*l.text);
+            if (l.meter) {
+                out.append(" [");
+                l.pattern->append_to(out);
+                out.append(' ');
+                out.append(l.meter);
+                out.append(']');
+            }
+            out.append('\n');
+            break;
+        case ReportFormat::csv:
+            csv_header();
+            out.append("line,");
+            verse_label(l);
+            out.append(',');
+            out.append_int(l.syllables);
+            out.append(l.uvaca ? ",1," : ",0,");
+            if (l.meter) {
+                l.pattern->append_to(out);
+                out.append(',');
+                csv_string(l.meter);
+            } else {
+                out.append(',');
+            }
+            out.append(',');
+            csv_string(*l.text);
+            out.append('\n');
+            break;
+        case ReportFormat::ndjson:
+            out.append("{\"type\":\"line\",\"verse\":\"");
+            verse_label(l);
+            out.append("\",\"syllables\":");
+            out.append_int(l.syllables);
+            out.append(l.uvaca ? ",\"uvaca\":true" : ",\"uvaca\":false");
+            if (l.meter) {
+                out.append(",\"pattern\":\"");
+                l.pattern->append_to(out);
+                out.append("\",\"meter\":");
+                json_string(l.meter);
+            }
+            out.append(",\"text\":");
+            json_string(*l.text);
+            out.append("}\n");
+            break;
+        }
+    }
+
+    // heading of one file's results in a batch run
+    void file(std::string const & name) {
+        switch (format_) {
+        case ReportFormat::text:
+            out.append("file ");
+            out.append(name);
+            out.append('\n');
+            break;
+        case ReportFormat::csv:
+            csv_header();
+            out.append("file,,,,,,");
+            csv_string(name);
+            out.append('\n');
+            break;
+        case ReportFormat::ndjson:
+            out.append("{\"type\":\"file\",\"file\":");
+            json_string(name);
+            out.append("}\n");
+            break;
+        }
+    }
+
+    // number of files in a batch run, before its grand totals
+    void files(int count) {
+        switch (format_) {
+        case ReportFormat::text:
+            out.append("files: ");
+            out.append_int(count);
+            out.append('\n');
+            break;
+        case ReportFormat::csv:
+            csv_header();
+            out.append("files,,");
+            out.append_int(count);
+            out.append(",,,,\n");
+            break;
+        case ReportFormat::ndjson:
+            out.append("{\"type\":\"files\",\"files\":");
+            out.append_int(count);
+            out.append("}\n");
+            break;
+        }
+    }
+
+    void chapter(std::string const & name, int syllables) {
+        switch (format_) {
+        case ReportFormat::text:
+            out.append("chapter ");
+            out.append(name);
+            out.append(": ");
+            out.append_int(syllables);
+            out.append('\n');
+            break;
+        case ReportFormat::csv:
+            csv_header();
+            out.append("chapter,");
+            out.append(name);
+            out.append(',');
+            out.append_int(syllables);
+            out.append(",,,,\n");
+            break;
+        case ReportFormat::ndjson:
+            out.append("{\"type\":\"chapter\",\"chapter\":\"");
+            out.append(name);
+            out.append("\",\"syllables\":");
+            out.append_int(syllables);
+            out.append("}\n");
+            break;
+        }
+    }
+
+    void chapter_meter(std::string const & chapter, std::string const & meter, int lines) {
+        switch (format_) {
+        case ReportFormat::text:
+            out.append("    ");
+            out.append(meter);
+            out.append(": ");
+            out.append_int(lines);
+            out.append('\n');
+            break;
+        case ReportFormat::csv:
+            csv_header();
+            out.append("meter,");
+            out.append(chapter);
+            out.append(',');
+            out.append_int(lines);
+            out.append(",,,");
+            csv_string(meter);
+            out.append(",\n");
+            break;
+        case ReportFormat::ndjson:
+            out.append("{\"type\":\"meter\",\"chapter\":\"");
+            out.append(chapter);
+            out.append("\",\"meter\":");
+            json_string(meter);
+            out.append(",\"lines\":");
+            out.append_int(lines);
+            out.append("}\n");
+            break;
+        }
+    }
+
+    void totals(int syllables, int syllables_no_uvaca) {
+        switch (format_) {
+        case ReportFormat::text:
+            out.append("total syllables: ");
+            out.append_int(syllables);
+            out.append("\ntotal syllables (no uvaaca): ");
+            out.append_int(syllables_no_uvaca);
+            out.append('\n');
+            break;
+        case ReportFormat::csv:
+            csv_header();
+            out.append("total,,");
+            out.append_int(syllables);
+            out.append(",,,,\ntotal_no_uvaca,,");
+            out.append_int(syllables_no_uvaca);
+            out.append(",,,,\n");
+            break;
+        case ReportFormat::ndjson:
+            out.append("{\"type\":\"total\",\"syllables\":");
+            out.append_int(syllables);
+            out.append(",\"syllables_no_uvaca\":");
+            out.append_int(syllables_no_uvaca);
+            out.append("}\n");
+            break;
+        }
+    }
+
+    void flush() {
+        out.flush();
+    }
+
+    // true once part of the report couldn't be written
+    bool failed() const {
+        return out.failed();
+    }
+
+private:
+    ReportFormat format_;
+    OutputBuffer out;
+    bool csv_header_done = false;
+
+    void verse_label(ReportLine const & l) {
+        out.append_int(verse_canto(l.id));
+        out.append('.');
+        out.append_int(verse_chapter(l.id));
+        out.append('.');
+        text_label(l.id);
+        if (l.last_id != l.id) {
+            out.append('-');
+            text_label(l.last_id);
+        }
+    }
+
+    void text_label(std::uint32_t id) {
+        out.append_int(verse_text(id));
+        if (verse_part(id)) {
+            out.append(static_cast<char>('a' + verse_part(id) - 1));
+        }
+    }
+
+    void csv_header() {
+        if (!csv_header_done) {
+            out.append("type,id,syllables,uvaca,pattern,meter,text\n");
+            csv_header_done = true;
+        }
+    }
+
+    void csv_string(std::string const & s) {
+        out.append('"');
+        for (char c: s) {
+            if (c == '"') out.append('"');
+            out.append(c);
+        }
+        out.append('"');
+    }
+
+    // JSON must be valid UTF-8: a byte that does not start a well-formed
+    // sequence (stray continuation, overlong form, surrogate, past U+10FFFF,
+    // cut short) is written as \ufffd
+    void json_string(std::string const & s) {
+        static char const hex[] = "0123456789abcdef";
+        out.append('"');
+        char const * p = s.data();
+        char const * end = p + s.size();
+        while (p < end) {
+            char c = *p;
+            auto u = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\') {
+                out.append('\\');
+                out.append(c);
+                ++p;
+            } else if (u < 0x20) {
+                out.append("\\u00");
+                out.append(hex[u >> 4]);
+                out.append(hex[u & 0xf]);
+                ++p;
+            } else if (u < 0x80) {
+                out.append(c);
+                ++p;
+            } else if (auto n = utf8_sequence_length(p, end)) {
+                out.append(p, n);
+                p += n;
+            } else {
+                out.append("\\ufffd");
+                ++p;
+            }
+        }
+        out.append('"');
+    }
+
+    // length of the well-formed UTF-8 sequence of two to four bytes at p,
+    // or 0 if there is none
+    static std::size_t utf8_sequence_length(char const * p, char const * end) {
+        auto b = [p](std::size_t i) { return static_cast<unsigned char>(p[i]); };
+        auto left = static_cast<std::size_t>(end - p);
+        auto tail = [&](std::size_t i) { return i < left && (b(i) & 0xc0) == 0x80; };
+        unsigned char lead = b(0);
+        if (lead >= 0xc2 && lead <= 0xdf) return tail(1) ? 2 : 0;
+        if (lead >= 0xe0 && lead <= 0xef) {
+            if (!tail(1) || !tail(2)) return 0;
+            if (lead == 0xe0 && b(1) < 0xa0) return 0;     // overlong
+            if (lead == 0xed && b(1) >= 0xa0) return 0;    // surrogate
+            return 3;
+        }
+        if (lead >= 0xf0 && lead <= 0xf4) {
+            if (!tail(1) || !tail(2) || !tail(3)) return 0;
+            if (lead == 0xf0 && b(1) < 0x90) return 0;     // overlong
+            if (lead == 0xf4 && b(1) >= 0x90) return 0;    // past U+10FFFF
+            return 4;
+        }
+        return 0;
+    }
+};
+
+// Chapter and overall totals taken out of a counter, to be added up over
+// the chunks of a file or over files and printed later.
+struct CountTotals {
+    int syllables = 0;
+    int syllables_no_uvaca = 0;
+    std::map<std::string, int> by_chapter;
+    std::map<std::string, std::map<std::string, int>> meters_by_chapter;
+
+    void add(CountTotals const & other) {
+        syllables += other.syllables;
+        syllables_no_uvaca += other.syllables_no_uvaca;
+        for (auto & pair: other.by_chapter) by_chapter[pair.first] += pair.second;
+        for (auto & pair: other.meters_by_chapter) {
+            auto & meters = meters_by_chapter[pair.first];
+            for (auto & meter: pair.second) meters[meter.first] += meter.second;
+        }
+    }
+
+    // same records as the counters' print_totals()
+    void print(ReportWriter & writer, bool show_meters) const {
+        for (auto & pair: by_chapter) {
+            writer.chapter(pair.first, pair.second);
+            if (!show_meters) continue;
+            auto meters = meters_by_chapter.find(pair.first);
+            if (meters == meters_by_chapter.end()) continue;
+            for (auto & meter: meters->second) {
+                writer.chapter_meter(pair.first, meter.first, meter.second);
+            }
+        }
+        writer.totals(syllables, syllables_no_uvaca);
+    }
+};
+
+#endif
@@ -1,14 +1,23 @@
 #ifndef rtfparser_h
-#define rtfaprser_h
+#define rtfparser_h
 
+#include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <climits>
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <string>
+#include <vector>
+
+#include "arena.h"
+#include "input.h"
+#include "probes.h"
+#include "stats.h"
+#include "textscan.h"
 
 enum class Status {
 // RTF parser error codes
@@ -21,7 +30,8 @@ enum class Status {
     Assertion       = 6,      // Assertion failure
     EndOfFile       = 7,      // End of file reached while reading RTF
     InvalidKeyword  = 8,      // Invalid keyword
-    InvalidParam    = 9       // Invalid parameter
+    InvalidParam    = 9,      // Invalid parameter
+    ReadError       = 10      // Input couldn't be read or decompressed
 };
 
 struct font {
@@ -45,6 +55,11 @@ struct CHP
 template <class Outputter>
 class RtfParser {
 public:
+    RtfParser()
+    {
+        output_string.reserve(4096);    // runs of text between controls; reused
+    }
+
     // %%Function: RtfParse
     //
     // Step 1:
@@ -52,6 +67,17 @@ public:
     // Push and pop state at the start and end of RTF groups;
     // Send text to ParseChar for further processing.
     Status RtfParse(FILE *fp);
+    Status RtfParse(ByteSource &in);
+
+    // %%Function: RtfParseSome
+    //
+    // The same in steps, for readers that pull the output: RtfBegin, then
+    // RtfParseSome until fDone. A step stops once about cbStep more bytes of
+    // input have been read, so the input is only read as far as needed.
+    void RtfBegin(ByteSource &in);
+    Status RtfParseSome(long cbStep, bool &fDone);
+
+    Outputter & GetOutputter() { return outputter; }
 
 private:
     enum RDS { rdsNorm, rdsSkip };              // Rtf Destination State
@@ -66,7 +92,7 @@ private:
                   ipropHidden,
                   ipropMax };
 
-    enum IPFN {ipfnBin, ipfnHex, ipfnSkipDest };
+    enum IPFN {ipfnBin, ipfnSkipDest, ipfnUnicode, ipfnUnicodeSkip };
     enum IDEST {idestPict, idestSkip };
 
     enum JUST {justL, justR, justC, justF };
@@ -101,7 +127,7 @@ private:
         char fLandscape=false;      // landscape or portrait?
     };                  // Document Properties
 
-    enum RIS { risNorm, risBin, risHex };       // Rtf Internal State
+    enum RIS { risNorm, risBin };               // Rtf Internal State
 
     struct SAVE             // property save structure
     {
@@ -112,6 +138,7 @@ private:
         DOP dop;
         RDS rds;
         RIS ris;
+        int cUcSkip;
     };
 
     enum ACTN {actnSpec, actnByte, actnWord};
@@ -140,14 +167,24 @@ private:
     bool fSkipDestIfUnk=false;
     long cbBin=0;
     long lParam=0;
+    ByteSource *pSource{};
+    char *pIn{};                // current chunk of input
+    char *pInEnd{};
+    char *pChunk{};
+    long cbBefore=0;            // input before the current chunk
     RDS rds{};
     RIS ris{};
+    int cUcSkip=1;              // \ucN: fallback characters after each \uN
+    int cSkipPending=0;         // fallback characters still to drop
+    unsigned wHighSurrogate=0;  // \uN of a surrogate pair waiting for its second half
 
     CHP chp{};
     PAP pap{};
     SEP sep{};
     DOP dop{};
     SAVE *psave{};
+    SAVE *psaveFree{};          // popped SAVEs, reused by the next push
+    Arena arena{4096};          // group stack; released with the parser
 
     std::string output_string;
     Outputter outputter{};
@@ -159,11 +196,15 @@ private:
     // Keyword descriptions
     static const RtfParser::SYM rgsymRtf[];
     static std::size_t isymMax;
+    static std::size_t LookupKeyword(const char *szKeyword);
+    static std::vector<std::size_t> BuildKeywordTable();
+    static std::size_t HashKeyword(const char *szKeyword);
 
     Status PushRtfState(void);
     Status PopRtfState(void);
-    Status ParseRtfKeyword(FILE *fp);
+    Status ParseRtfKeyword();
     Status ParseChar(int c);
+    Status ParseRun(const char *pch, std::size_t cch);
     Status TranslateKeyword(char *szKeyword, int param, bool fParam);
     Status PrintChar(int ch);
     Status EndGroupAction(RDS rds);
@@ -172,19 +213,81 @@ private:
     Status ParseSpecialKeyword(IPFN ipfn);
     Status ParseSpecialProperty(IPROP iprop, int val);
     Status ParseHexByte(void);
+    Status ParseUnicode(long n);
+    Status PrintUnicode(unsigned cp);
     void FlushOutputString();
     void SendOutputString(std::string const & string);
+
+    int GetChar()
+    {
+        if (pIn == pInEnd && !NextChunk())
+            return EOF;
+        return static_cast<unsigned char>(*pIn++);
+    }
+
+    // only right after GetChar, which leaves the character in the chunk
+    void UngetChar(int ch)
+    {
+        if (ch != EOF)
+            pIn--;
+    }
+
+    bool NextChunk()
+    {
+        std::size_t size;
+        cbBefore += pInEnd - pChunk;
+        pIn = pInEnd = pChunk = nullptr;
+        if (!pSource->next(pChunk, size))
+            return false;
+        pIn = pChunk;
+        pInEnd = pChunk + size;
+        return true;
+    }
+
+    // input offset, for probes and --stats
+    long InputOffset() const
+    {
+        return cbBefore + (pIn - pChunk);
+    }
 };
 
 template <class Outputter>
 Status RtfParser<Outputter>::RtfParse(FILE *fp)
 {
+    FileSource in(fp);
+    return RtfParse(in);
+}
+
+template <class Outputter>
+Status RtfParser<Outputter>::RtfParse(ByteSource &in)
+{
+    bool fDone;
+    RtfBegin(in);
+    return RtfParseSome(LONG_MAX, fDone);
+}
+
+template <class Outputter>
+void RtfParser<Outputter>::RtfBegin(ByteSource &in)
+{
+    pSource = &in;
+}
+
+template <class Outputter>
+Status RtfParser<Outputter>::RtfParseSome(long cbStep, bool &fDone)
+{
+    StatsStage stage(Stage::tokenize);
+    long start = InputOffset();
+    long cbLimit = cbStep > LONG_MAX - start ? LONG_MAX : start + cbStep;
     int ch;
     Status ec;
-    int cNibble = 2;
-    int b = 0;
-    while ((ch = getc(fp)) != EOF)
+    fDone = false;
+    while (InputOffset() < cbLimit)
     {
+        if ((ch = GetChar()) == EOF)
+        {
+            fDone = true;
+            break;
+        }
         if (cGroup < 0)
             return Status::StackUnderflow;
         if (ris == risBin)                      // if we’re parsing binary data, handle it directly
@@ -198,63 +301,40 @@ Status RtfParser<Outputter>::RtfParse(FILE *fp)
             {
             case '{':
                 FlushOutputString();
+                cSkipPending = 0;
                 if ((ec = PushRtfState()) != Status::OK)
                     return ec;
                 break;
             case '}':
                 FlushOutputString();
+                cSkipPending = 0;
                 if ((ec = PopRtfState()) != Status::OK)
                     return ec;
                 break;
             case '\\':
-                if ((ec = ParseRtfKeyword(fp)) != Status::OK)
+                if ((ec = ParseRtfKeyword()) != Status::OK)
                     return ec;
                 break;
             case 0x0d:
             case 0x0a:          // cr and lf are noise characters...
                 break;
             default:
-                if (ris == risNorm)
                 {
-                    if ((ec = ParseChar(ch)) != Status::OK)
+                    // the rest of the run of plain text in this chunk goes in one piece
+                    char *pRun = pIn - 1;
+                    pIn += scan_plain_text(pIn, pInEnd) - pIn;
+                    if ((ec = ParseRun(pRun, static_cast<std::size_t>(pIn - pRun))) != Status::OK)
                         return ec;
                 }
-                else
-                {               // parsing hex data
-                    if (ris != risHex)
-                        return Status::Assertion;
-                    b = b << 4;
-                    if (isdigit(ch))
-                        b += static_cast<char>(ch) - '0';
-                    else
-                    {
-                        if (islower(ch))
-                        {
-                            if (ch < 'a' || ch > 'f')
-                                return Status::InvalidHex;
-                            b += static_cast<char>(ch) - 'a' + 10;
-                        }
-                        else
-                        {
-                            if (ch < 'A' || ch > 'F')
-                                return Status::InvalidHex;
-                            b += static_cast<char>(ch) - 'A' + 10;
-                        }
-                    }
-                    cNibble--;
-                    if (!cNibble)
-                    {
-                        if ((ec = ParseChar(b)) != Status::OK)
-                            return ec;
-                        cNibble = 2;
-                        b = 0;
-                        ris = risNorm;
-                    }
-                }                   // end else (ris != risNorm)
                 break;
             }       // switch
         }           // else (ris != risBin)
     }               // while
+    stats_count(StatCounter::bytes, static_cast<std::uint64_t>(InputOffset() - start));
+    if (!fDone)
+        return Status::OK;
+    if (!pSource->error().empty())
+        return Status::ReadError;
     if (cGroup < 0)
         return Status::StackUnderflow;
     if (cGroup > 0)
@@ -269,9 +349,22 @@ Status RtfParser<Outputter>::RtfParse(FILE *fp)
 template <class Outputter>
 Status RtfParser<Outputter>::PushRtfState(void)
 {
-    SAVE *psaveNew = static_cast<SAVE *>(malloc(sizeof(SAVE)));
-    if (!psaveNew)
-        return Status::StackOverflow;
+    StatsStage stage(Stage::group);
+    stats_count(StatCounter::groups);
+    SAVE *psaveNew = psaveFree;
+    if (psaveNew)
+        psaveFree = psaveNew->pNext;
+    else
+    {
+        try
+        {
+            psaveNew = new (arena.allocate(sizeof(SAVE), alignof(SAVE))) SAVE;
+        }
+        catch (std::bad_alloc const &)
+        {
+            return Status::StackOverflow;
+        }
+    }
 
     psaveNew -> pNext = psave;
     psaveNew -> chp = chp;
@@ -280,9 +373,11 @@ Status RtfParser<Outputter>::PushRtfState(void)
     psaveNew -> dop = dop;
     psaveNew -> rds = rds;
     psaveNew -> ris = ris;
+    psaveNew -> cUcSkip = cUcSkip;
     ris = risNorm;
     psave = psaveNew;
     cGroup++;
+    SB_PROBE2(group_push, cGroup, InputOffset());
     return Status::OK;
 }
 
@@ -295,6 +390,7 @@ Status RtfParser<Outputter>::PushRtfState(void)
 template <class Outputter>
 Status RtfParser<Outputter>::PopRtfState(void)
 {
+    StatsStage stage(Stage::group);
     SAVE *psaveOld;
     Status ec;
 
@@ -312,11 +408,14 @@ Status RtfParser<Outputter>::PopRtfState(void)
     dop = psave->dop;
     rds = psave->rds;
     ris = psave->ris;
+    cUcSkip = psave->cUcSkip;
 
     psaveOld = psave;
     psave = psave->pNext;
     cGroup--;
-    free(psaveOld);
+    psaveOld->pNext = psaveFree;
+    psaveFree = psaveOld;
+    SB_PROBE2(group_pop, cGroup, InputOffset());
     return Status::OK;
 }
 
@@ -327,7 +426,7 @@ Status RtfParser<Outputter>::PopRtfState(void)
 // call TranslateKeyword to dispatch the control.
 
 template <class Outputter>
-Status RtfParser<Outputter>::ParseRtfKeyword(FILE *fp)
+Status RtfParser<Outputter>::ParseRtfKeyword()
 {
     int ch;
     char fParam = false;
@@ -342,15 +441,20 @@ Status RtfParser<Outputter>::ParseRtfKeyword(FILE *fp)
     lParam = 0;
     szKeyword[0] = '\0';
     szParameter[0] = '\0';
-    if ((ch = getc(fp)) == EOF)
+    if ((ch = GetChar()) == EOF)
         return Status::EndOfFile;
+    if (ch == '\'')              // \'xx, the commonest control by far
+    {
+        stats_count(StatCounter::keywords);
+        return ParseHexByte();
+    }
     if (!isalpha(ch))           // a control symbol; no delimiter.
     {
         szKeyword[0] = static_cast<char>(ch);
         szKeyword[1] = '\0';
         return TranslateKeyword(szKeyword, 0, fParam);
     }
-    for (pch = szKeyword; pch < pKeywordMax && isalpha(ch); ch = getc(fp))
+    for (pch = szKeyword; pch < pKeywordMax && isalpha(ch); ch = GetChar())
         *pch++ = static_cast<char>(ch);
     if (pch >= pKeywordMax)
         return Status::InvalidKeyword;  // Keyword too long
@@ -358,13 +462,13 @@ Status RtfParser<Outputter>::ParseRtfKeyword(FILE *fp)
     if (ch == '-')
     {
         fNeg  = true;
-        if ((ch = getc(fp)) == EOF)
+        if ((ch = GetChar()) == EOF)
             return Status::EndOfFile;
     }
     if (isdigit(ch))
     {
         fParam = true;         // a digit after the control means we have a parameter
-        for (pch = szParameter; pch < pParamMax && isdigit(ch); ch = getc(fp))
+        for (pch = szParameter; pch < pParamMax && isdigit(ch); ch = GetChar())
             *pch++ = static_cast<char>(ch);
         if (pch >= pParamMax)
             return Status::InvalidParam;    // Parameter too long
@@ -375,7 +479,7 @@ Status RtfParser<Outputter>::ParseRtfKeyword(FILE *fp)
         lParam = param;
     }
     if (ch != ' ')
-        ungetc(ch, fp);
+        UngetChar(ch);
     return TranslateKeyword(szKeyword, param, fParam);
 }
 
@@ -386,8 +490,16 @@ Status RtfParser<Outputter>::ParseRtfKeyword(FILE *fp)
 template <class Outputter>
 Status RtfParser<Outputter>::ParseChar(int ch)
 {
-    if (ris == risBin && --cbBin <= 0)
-        ris = risNorm;
+    if (ris == risBin)
+    {
+        if (--cbBin <= 0)
+            ris = risNorm;
+    }
+    else if (cSkipPending > 0)  // fallback for the last \uN
+    {
+        cSkipPending--;
+        return Status::OK;
+    }
     switch (rds)
     {
     case rdsSkip:
@@ -402,6 +514,25 @@ Status RtfParser<Outputter>::ParseChar(int ch)
     }
 }
 
+// %%Function: ParseRun
+//
+// ParseChar for a run of plain text, outside \bin data.
+
+template <class Outputter>
+Status RtfParser<Outputter>::ParseRun(const char *pch, std::size_t cch)
+{
+    if (cSkipPending > 0)       // fallback for the last \uN
+    {
+        std::size_t cchSkip = std::min(cch, static_cast<std::size_t>(cSkipPending));
+        cSkipPending -= static_cast<int>(cchSkip);
+        pch += cchSkip;
+        cch -= cchSkip;
+    }
+    if (rds == rdsNorm)
+        output_string.append(pch, cch);
+    return Status::OK;
+}
+
 //
 // %%Function: PrintChar
 //
@@ -415,6 +546,109 @@ Status RtfParser<Outputter>::PrintChar(int ch)
     return Status::OK;
 }
 
+// %%Function: ParseHexByte
+//
+// The two hex digits of \'xx, read straight from the input and looked up
+// in a table; CR and LF between them are noise, as everywhere else.
+
+template <class Outputter>
+Status RtfParser<Outputter>::ParseHexByte(void)
+{
+    static const struct HexTable
+    {
+        signed char value[256];
+        HexTable()
+        {
+            memset(value, -1, sizeof value);
+            for (int c = 0; c < 10; c++)
+                value['0' + c] = static_cast<signed char>(c);
+            for (int c = 0; c < 6; c++)
+                value['a' + c] = value['A' + c] = static_cast<signed char>(10 + c);
+        }
+    } hex;
+    int b = 0;
+    for (int cNibble = 2; cNibble > 0; )
+    {
+        int ch = GetChar();
+        if (ch == EOF)
+            return Status::EndOfFile;
+        if (ch == 0x0d || ch == 0x0a)
+            continue;
+        if (hex.value[ch] < 0)
+        {
+            if (rds != rdsSkip)
+                return Status::InvalidHex;
+            UngetChar(ch);      // junk in a skipped destination; leave it to the main loop
+            return Status::OK;
+        }
+        b = b << 4 | hex.value[ch];
+        cNibble--;
+    }
+    return ParseChar(b);
+}
+
+// %%Function: ParseUnicode
+//
+// \uN: the character N (signed 16 bits, so negative above 32767) as UTF-8.
+// A surrogate pair comes as two \uN; a half without the other is U+FFFD.
+// The next \ucN characters are the fallback for readers without Unicode.
+
+template <class Outputter>
+Status RtfParser<Outputter>::ParseUnicode(long n)
+{
+    Status ec;
+    if (n < 0)
+        n += 65536;
+    cSkipPending = cUcSkip;
+    unsigned cp = n >= 0 && n < 65536 ? static_cast<unsigned>(n) : 0xfffd;
+    if (cp >= 0xdc00 && cp < 0xe000)
+    {
+        cp = wHighSurrogate ? 0x10000 + ((wHighSurrogate - 0xd800) << 10) + (cp - 0xdc00) : 0xfffd;
+        wHighSurrogate = 0;
+        return PrintUnicode(cp);
+    }
+    if (wHighSurrogate)
+    {
+        wHighSurrogate = 0;
+        if ((ec = PrintUnicode(0xfffd)) != Status::OK)
+            return ec;
+    }
+    if (cp >= 0xd800 && cp < 0xdc00)
+    {
+        wHighSurrogate = cp;
+        return Status::OK;
+    }
+    return PrintUnicode(cp);
+}
+
+template <class Outputter>
+Status RtfParser<Outputter>::PrintUnicode(unsigned cp)
+{
+    if (rds != rdsNorm)
+        return Status::OK;
+    if (cp < 0x80)
+        output_string += static_cast<char>(cp);
+    else if (cp < 0x800)
+    {
+        output_string += static_cast<char>(0xc0 | cp >> 6);
+        output_string += static_cast<char>(0x80 | (cp & 0x3f));
+    }
+    else if (cp < 0x10000)
+    {
+        output_string += static_cast<char>(0xe0 | cp >> 12);
+        output_string += static_cast<char>(0x80 | (cp >> 6 & 0x3f));
+        output_string += static_cast<char>(0x80 | (cp & 0x3f));
+    }
+    else
+    {
+        output_string += static_cast<char>(0xf0 | cp >> 18);
+        output_string += static_cast<char>(0x80 | (cp >> 12 & 0x3f));
+        output_string += static_cast<char>(0x80 | (cp >> 6 & 0x3f));
+        output_string += static_cast<char>(0x80 | (cp & 0x3f));
+    }
+    return Status::OK;
+}
+
 template <class Outputter>
 const typename RtfParser<Outputter>::PROP RtfParser<Outputter>::rgprop [RtfParser<Outputter>::ipropMax] = {
     actnByte,   propChp,    offsetof(CHP, fBold),       // ipropBold
@@ -450,7 +684,8 @@ const typename RtfParser<Outputter>::SYM RtfParser<Outputter>::rgsymRtf[] = {
 //  keyword     dflt    fPassDflt  kwd         idx
     "b",        1,      false,     kwdProp,    ipropBold,
     "v",        1,      false,     kwdProp,    ipropHidden,
-    "u",        1,      false,     kwdProp,    ipropUnderline,
+    "ul",       1,      false,     kwdProp,    ipropUnderline,
+    "ulnone",   0,      true,      kwdProp,    ipropUnderline,
     "i",        1,      false,     kwdProp,    ipropItalic,
     "f",        0,      false,     kwdProp,    ipropFont,
     "li",       0,      false,     kwdProp,    ipropLeftInd,
@@ -490,7 +725,8 @@ const typename RtfParser<Outputter>::SYM RtfParser<Outputter>::rgsymRtf[] = {
     "rdblquote",0,      false,     kwdChar,    0x201d,
     "bin",      0,      false,     kwdSpec,    ipfnBin,
     "*",        0,      false,     kwdSpec,    ipfnSkipDest,
-    "'",        0,      false,     kwdSpec,    ipfnHex,
+    "u",        0,      false,     kwdSpec,    ipfnUnicode,
+    "uc",       1,      false,     kwdSpec,    ipfnUnicodeSkip,
     "author",   0,      false,     kwdDest,    idestSkip,
     "buptim",   0,      false,     kwdDest,    idestSkip,
     "colortbl", 0,      false,     kwdDest,    idestSkip,
@@ -588,13 +824,13 @@ Status RtfParser<Outputter>::ParseSpecialProperty(IPROP iprop, int/* val*/)
     switch (iprop)
     {
     case ipropPard:
-        memset(&pap, 0, sizeof(pap));
+        pap = PAP{};
         return Status::OK;
     case ipropPlain:
-        memset(&chp, 0, sizeof(chp));
+        chp = CHP{};
         return Status::OK;
     case ipropSectd:
-        memset(&sep, 0, sizeof(sep));
+        sep = SEP{};
         return Status::OK;
     default:
         return Status::BadTable;
@@ -615,14 +851,24 @@ Status RtfParser<Outputter>::TranslateKeyword(char *szKeyword, int param, bool f
 {
     std::size_t isym;
 
-    // search for szKeyword in rgsymRtf
-    for (isym = 0; isym < isymMax; isym++)
-        if (strcmp(szKeyword, rgsymRtf[isym].szKeyword) == 0)
-            break;
+    stats_count(StatCounter::keywords);
+    SB_PROBE3(keyword, szKeyword, param, InputOffset());
+    if (cSkipPending > 0)           // a control is one fallback character for \uN
+    {
+        cSkipPending--;
+        return Status::OK;
+    }
+    {
+        StatsStage stage(Stage::keyword);
+        isym = LookupKeyword(szKeyword);
+    }
     if (isym == isymMax)            // control word not found
     {
         if (fSkipDestIfUnk)         // if this is a new destination
+        {
             rds = rdsSkip;          // skip the destination
+            stats_count(StatCounter::skipped_destinations);
+        }
                                     // else just discard it
         fSkipDestIfUnk = false;
         FlushOutputString();
@@ -644,6 +890,8 @@ Status RtfParser<Outputter>::TranslateKeyword(char *szKeyword, int param, bool f
         FlushOutputString();
         return ChangeDest(static_cast<IDEST>(rgsymRtf[isym].idx));
     case kwdSpec:
+        if (!fParam)                // a bare \uc is \uc1, as the table says
+            lParam = rgsymRtf[isym].dflt;
         return ParseSpecialKeyword(static_cast<IPFN>(rgsymRtf[isym].idx));
     default:
         FlushOutputString();
@@ -651,6 +899,53 @@ Status RtfParser<Outputter>::TranslateKeyword(char *szKeyword, int param, bool f
     }
 }
 
+// %%Function: LookupKeyword
+//
+// Index of szKeyword in rgsymRtf, or isymMax if it isn't there. Hashed
+// instead of searching the table: a document has a keyword every few bytes.
+
+template <class Outputter>
+std::size_t RtfParser<Outputter>::LookupKeyword(const char *szKeyword)
+{
+    static const std::vector<std::size_t> table = BuildKeywordTable();
+    std::size_t mask = table.size() - 1;
+    for (std::size_t h = HashKeyword(szKeyword) & mask; table[h] != isymMax; h = (h + 1) & mask)
+        if (strcmp(szKeyword, rgsymRtf[table[h]].szKeyword) == 0)
+            return table[h];
+    return isymMax;
+}
+
+// Open addressing over a power of two at least 4 times the keyword count;
+// empty slots hold isymMax. The first of duplicate keywords wins, as it
+// did with the linear search.
+
+template <class Outputter>
+std::vector<std::size_t> RtfParser<Outputter>::BuildKeywordTable()
+{
+    std::size_t size = 1;
+    while (size < 4 * isymMax)
+        size *= 2;
+    std::vector<std::size_t> table(size, isymMax);
+    for (std::size_t isym = 0; isym < isymMax; isym++)
+    {
+        std::size_t h = HashKeyword(rgsymRtf[isym].szKeyword) & (size - 1);
+        while (table[h] != isymMax && strcmp(rgsymRtf[table[h]].szKeyword, rgsymRtf[isym].szKeyword) != 0)
+            h = (h + 1) & (size - 1);
+        if (table[h] == isymMax)
+            table[h] = isym;
+    }
+    return table;
+}
+
+template <class Outputter>
+std::size_t RtfParser<Outputter>::HashKeyword(const char *szKeyword)
+{
+    std::size_t h = 2166136261u;            // FNV-1a
+    for (; *szKeyword; szKeyword++)
+        h = (h ^ static_cast<unsigned char>(*szKeyword)) * 16777619u;
+    return h;
+}
+
 // %%Function: ChangeDest
 // Change to the destination specified by idest.
 // There's usually more to do here than this...
@@ -662,6 +957,7 @@ Status RtfParser<Outputter>::ChangeDest(IDEST/* idest*/)
         return Status::OK;                // Do not do anything
 
     rds = rdsSkip;              // when in doubt, skip it...
+    stats_count(StatCounter::skipped_destinations);
     return Status::OK;
 }
 
@@ -696,8 +992,12 @@ Status RtfParser<Outputter>::ParseSpecialKeyword(IPFN ipfn)
         FlushOutputString();
         fSkipDestIfUnk = true;
         break;
-    case ipfnHex:
-        ris = risHex;
+    case ipfnUnicode:
+        if (lParam != 0)
+            return ParseUnicode(lParam);
+        break;
+    case ipfnUnicodeSkip:
+        cUcSkip = lParam > 0 ? static_cast<int>(lParam) : 0;
         break;
     default:
         FlushOutputString();
@@ -710,6 +1010,7 @@ template <class Outputter>
 void RtfParser<Outputter>::FlushOutputString()
 {
     if (!output_string.empty()) {
+        SB_PROBE2(flush, output_string.size(), InputOffset());
         SendOutputString(output_string);
         output_string = "";
     }
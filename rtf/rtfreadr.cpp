@@ -1,35 +1,244 @@
-#include <iostream>
+// RTF to plain text.
+//
+//   rtfreadr [--font N]... [--no-hidden] [--jobs N] [-o DIR] FILE...
+//
+// Converts each FILE (plain, .gz or .zst) to DIR/<name>.txt, several files
+// at a time, or to stdout one after another without -o. --font keeps only
+// text in the given font numbers (repeatable), --no-hidden drops \v text.
+// Without files it converts test.rtf to stdout, as it always has.
+
+#include <fcntl.h>
+#include <set>
 #include <string>
+#include <thread>
+#include <vector>
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "input.h"
+#include "report-writer.h"
 #include "rtfparser.h"
+#include "stats.h"
+#include "work-pool.h"
 
-class CoutOutputter {
+struct Options {
+    std::vector<bool> fonts;    // fonts to keep; empty: all
+    bool drop_hidden = false;
+};
+
+// Text runs that pass the font and hidden filters, in large blocks.
+class TextOutputter {
 public:
-    void write(std::string const & string, CHP const & /*chp*/) {
-        std::cout << string;
+    void write(std::string const & string, CHP const & chp)
+    {
+        StatsStage stage(Stage::output);
+        if (options.drop_hidden && chp.hidden)
+            return;
+        if (!options.fonts.empty())
+        {
+            auto f = static_cast<std::size_t>(int(chp.cur_font));
+            if (f >= options.fonts.size() || !options.fonts[f])
+                return;
+        }
+        out.append(string);
     }
+
+    void set_options(Options const & o) { options = o; }
+    void set_fd(int fd) { out.set_fd(fd); }
+    void flush() { out.flush(); }
+    bool failed() const { return out.failed(); }
+
+private:
+    Options options;
+    OutputBuffer out;
 };
 
+// Converts one input to fd; an empty string or the error.
+static std::string convert(std::string const & name, int fd, Options const & options)
+{
+    std::string error;
+    auto in = open_input(name, error);
+    if (!in)
+        return error;
+    RtfParser<TextOutputter> p;
+    p.GetOutputter().set_options(options);
+    p.GetOutputter().set_fd(fd);
+    Status ec = p.RtfParse(*in);
+    p.GetOutputter().flush();
+    if (ec == Status::ReadError)
+        return in->error();
+    if (ec != Status::OK)
+        return "error " + std::to_string(static_cast<int>(ec)) + " parsing rtf";
+    if (p.GetOutputter().failed())
+        return "write error";
+    return "";
+}
+
+// "dir/sb.rtf.gz" -> "sb.txt"
+static std::string output_name(std::string name)
+{
+    auto slash = name.find_last_of("/\\");
+    if (slash != std::string::npos)
+        name.erase(0, slash + 1);
+    for (char const *suffix: {".gz", ".zst", ".rtf"})
+    {
+        std::string s = suffix;
+        if (name.size() > s.size() && name.compare(name.size() - s.size(), s.size(), s) == 0)
+            name.erase(name.size() - s.size());
+    }
+    return name + ".txt";
+}
+
+static int create_file(std::string const & name)
+{
+#ifdef _WIN32
+    return _open(name.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    return open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+}
+
+static void close_file(int fd)
+{
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
 // %%Function: main
 //
 // Main loop. Initialize and parse RTF.
-int main()
+int main(int argc, char *argv[])
 {
-    FILE *fp;
+    bool stats = false;
+    char const *stats_json_name = nullptr;
+    Options options;
+    unsigned jobs = std::thread::hardware_concurrency();
+    std::string out_dir;
+    std::vector<std::string> inputs;
 
-    fp = fopen("test.rtf", "r");
-    if (!fp)
+    for (int i = 1; i < argc; ++i)
     {
-        printf ("Can't open test file!\n");
-        return 1;
+        std::string arg = argv[i];
+        if (arg == "--stats")
+            stats = true;
+        else if (arg == "--stats-json" && i + 1 < argc)
+            stats_json_name = argv[++i];
+        else if (arg == "--font" && i + 1 < argc)
+        {
+            int f = atoi(argv[++i]);
+            if (f < 0)
+            {
+                printf("bad font number: %s\n", argv[i]);
+                return 1;
+            }
+            auto index = static_cast<std::size_t>(f);
+            if (options.fonts.size() <= index)
+                options.fonts.resize(index + 1);
+            options.fonts[index] = true;
+        }
+        else if (arg == "--no-hidden")
+            options.drop_hidden = true;
+        else if (arg == "--jobs" && i + 1 < argc)
+        {
+            if (!parse_jobs(argv[++i], jobs))
+            {
+                printf("bad job count: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (arg == "-o" && i + 1 < argc)
+            out_dir = argv[++i];
+        else if (arg.compare(0, 1, "-") == 0)
+        {
+            printf("unknown option: %s\n", argv[i]);
+            return 1;
+        }
+        else
+            inputs.push_back(arg);
+    }
+
+    if (inputs.empty())
+    {
+        std::string error;
+        auto in = open_input_or_compressed("test.rtf", error);
+        if (!in)
+        {
+            printf ("Can't open test file!\n");
+            return 1;
+        }
+
+        if (stats || stats_json_name)
+            run_stats.start();
+
+        Status ec;
+        RtfParser<TextOutputter> p;
+        p.GetOutputter().set_options(options);
+        ec = p.RtfParse(*in);
+        p.GetOutputter().flush();
+        if (ec == Status::ReadError)
+            printf("error reading test.rtf: %s\n", in->error().c_str());
+        else if (ec != Status::OK)
+            printf("error %d parsing rtf\n", static_cast<int>(ec));
+        else
+            printf("Parsed RTF file OK\n");
+        return report_stats(stats, stats_json_name) ? 0 : 1;
     }
 
-    Status ec;
-    RtfParser<CoutOutputter> p;
-    if ((ec = p.RtfParse(fp)) != Status::OK)
-        printf("error %d parsing rtf\n", static_cast<int>(ec));
+    if (stats || stats_json_name)
+        run_stats.start();
+
+    std::vector<std::string> errors(inputs.size());
+    if (out_dir.empty())
+    {
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+            errors[i] = convert(inputs[i], 1, options);
+    }
     else
-        printf("Parsed RTF file OK\n");
-    fclose(fp);
-    return 0;
+    {
+        std::set<std::string> outputs;
+        for (auto & name: inputs)
+        {
+            if (!outputs.insert(output_name(name)).second)
+            {
+                printf("%s: more than one input would be written to %s\n",
+                       name.c_str(), output_name(name).c_str());
+                return 1;
+            }
+        }
+        WorkPool pool(jobs);
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+        {
+            pool.submit([&, i]
+            {
+                std::string out_name = out_dir + '/' + output_name(inputs[i]);
+                int fd = create_file(out_name);
+                if (fd < 0)
+                {
+                    errors[i] = "can't create " + out_name;
+                    return;
+                }
+                errors[i] = convert(inputs[i], fd, options);
+                close_file(fd);
+            });
+        }
+        pool.wait();
+    }
+
+    bool ok = true;
+    for (std::size_t i = 0; i < inputs.size(); ++i)
+    {
+        if (!errors[i].empty())
+        {
+            fprintf(stderr, "%s: %s\n", inputs[i].c_str(), errors[i].c_str());
+            ok = false;
+        }
+    }
+    return report_stats(stats, stats_json_name) && ok ? 0 : 1;
 }
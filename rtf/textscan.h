@@ -0,0 +1,91 @@
+#ifndef textscan_h
+#define textscan_h
+
+// Finds the end of a run of plain RTF text: the first '{', '}', '\\', CR or
+// LF in [p, end), or end. On x86 it compares 16 bytes at a time with SSE2,
+// or 32 with AVX2 when the CPU has it (checked once, at the first call);
+// elsewhere it goes byte by byte through a table.
+
+#include <cstddef>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SB_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+inline bool is_rtf_special(unsigned char c) {
+    return c == '{' || c == '}' || c == '\\' || c == '\r' || c == '\n';
+}
+
+inline char const * scan_plain_text_bytes(char const * p, char const * end) {
+    static const struct Table {
+        bool special[256];
+        Table() : special() {
+            for (int c = 0; c < 256; ++c) special[c] = is_rtf_special(static_cast<unsigned char>(c));
+        }
+    } table;
+    while (p < end && !table.special[static_cast<unsigned char>(*p)]) ++p;
+    return p;
+}
+
+#ifdef SB_SCAN_X86
+
+__attribute__((target("sse2")))
+inline char const * scan_plain_text_sse2(char const * p, char const * end) {
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p));
+        __m128i hit = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, open), _mm_cmpeq_epi8(v, close)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, backslash),
+                         _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf))));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+    return scan_plain_text_bytes(p, end);
+}
+
+__attribute__((target("avx2")))
+inline char const * scan_plain_text_avx2(char const * p, char const * end) {
+    const __m256i open = _mm256_set1_epi8('{');
+    const __m256i close = _mm256_set1_epi8('}');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p));
+        __m256i hit = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, open), _mm256_cmpeq_epi8(v, close)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, backslash),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, lf))));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+        if (mask) return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return scan_plain_text_sse2(p, end);
+}
+
+#endif
+
+typedef char const * (*PlainTextScanner)(char const *, char const *);
+
+inline PlainTextScanner choose_plain_text_scanner() {
+#ifdef SB_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return scan_plain_text_avx2;
+    if (__builtin_cpu_supports("sse2")) return scan_plain_text_sse2;
+#endif
+    return scan_plain_text_bytes;
+}
+
+inline char const * scan_plain_text(char const * p, char const * end) {
+    static const PlainTextScanner scanner = choose_plain_text_scanner();
+    return scanner(p, end);
+}
+
+#endif
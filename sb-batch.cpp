@@ -0,0 +1,389 @@
+// Counts a whole corpus in one process: every .rtf and .itx file (also
+// .gz/.zst) under the given directories, plus files named directly or by a
+// wildcard pattern, e.g.
+//
+//   sb-batch --jobs 8 corpus/ 'editions/sb-*.rtf'
+//
+// Files are counted on a work-stealing pool, largest first; plain ITX files
+// larger than --chunk-mb are split at chapter boundaries and their chunks
+// counted in parallel. Prints each file's chapter totals and totals in the
+// order the files were listed, then the totals over all of them.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#include "input.h"
+#include "report-writer.h"
+#include "sb-itx-sloka-counter.h"
+#include "sb-sloka-counter.h"
+#include "stats.h"
+#include "work-pool.h"
+
+enum class FileFormat { rtf, itx };
+
+struct FileJob {
+    std::string name;
+    FileFormat format;
+    bool compressed;
+    long size;
+    std::mutex mutex;       // guards totals and error, added to by every chunk
+    CountTotals totals;
+    std::string error;
+
+    void add(CountTotals const & t) {
+        std::lock_guard<std::mutex> lock(mutex);
+        totals.add(t);
+    }
+
+    void fail(std::string const & message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (error.empty()) error = message;
+    }
+};
+
+static bool ends_with(std::string const & s, std::string const & suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// format from the extension, under an optional .gz or .zst
+static bool file_format(std::string name, FileFormat & format, bool & compressed) {
+    compressed = false;
+    for (char const * suffix: {".gz", ".zst"}) {
+        if (ends_with(name, suffix)) {
+            name.erase(name.size() - std::string(suffix).size());
+            compressed = true;
+            break;
+        }
+    }
+    if (ends_with(name, ".rtf")) format = FileFormat::rtf;
+    else if (ends_with(name, ".itx")) format = FileFormat::itx;
+    else return false;
+    return true;
+}
+
+// '*' and '?' only
+static bool glob_match(char const * pattern, char const * name) {
+    if (*pattern == '\0') return *name == '\0';
+    if (*pattern == '*') {
+        for (char const * p = name; ; ++p) {
+            if (glob_match(pattern + 1, p)) return true;
+            if (*p == '\0') return false;
+        }
+    }
+    if (*name == '\0') return false;
+    return (*pattern == '?' || *pattern == *name) && glob_match(pattern + 1, name + 1);
+}
+
+static long file_size(std::string const & name) {
+    FILE * f = fopen(name.c_str(), "rb");
+    if (!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+// entries of a directory, sorted; false if it isn't one
+static bool list_directory(std::string const & dir, std::vector<std::string> & names,
+                           std::vector<bool> & is_dir) {
+    std::vector<std::pair<std::string, bool>> entries;
+#ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    HANDLE h = FindFirstFileA((dir + "\\*").c_str(), &data);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    do {
+        entries.emplace_back(data.cFileName, (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+    } while (FindNextFileA(h, &data));
+    FindClose(h);
+#else
+    DIR * d = opendir(dir.c_str());
+    if (!d) return false;
+    while (dirent * e = readdir(d)) {
+        struct stat st;
+        bool sub = stat((dir + '/' + e->d_name).c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+        entries.emplace_back(e->d_name, sub);
+    }
+    closedir(d);
+#endif
+    std::sort(entries.begin(), entries.end());
+    for (auto & e: entries) {
+        if (e.first == "." || e.first == "..") continue;
+        names.push_back(e.first);
+        is_dir.push_back(e.second);
+    }
+    return true;
+}
+
+class Corpus {
+public:
+    std::vector<std::unique_ptr<FileJob>> jobs;
+
+    // a directory (recursively), a wildcard pattern or a file
+    bool add(std::string const & path) {
+        if (add_directory(path)) return true;
+        auto slash = path.find_last_of("/\\");
+        std::string base = slash == std::string::npos ? path : path.substr(slash + 1);
+        if (base.find_first_of("*?") != std::string::npos) {
+            std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+            std::string prefix = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+            std::vector<std::string> names;
+            std::vector<bool> is_dir;
+            if (!list_directory(dir, names, is_dir)) return false;
+            for (std::size_t i = 0; i < names.size(); ++i) {
+                if (!is_dir[i] && glob_match(base.c_str(), names[i].c_str())) add_file(prefix + names[i], true);
+            }
+            return true;
+        }
+        return add_file(path, false);
+    }
+
+private:
+    bool add_directory(std::string const & dir) {
+        std::vector<std::string> names;
+        std::vector<bool> is_dir;
+        if (!list_directory(dir, names, is_dir)) return false;
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            std::string path = dir + '/' + names[i];
+            if (is_dir[i]) add_directory(path);
+            else add_file(path, true);
+        }
+        return true;
+    }
+
+    // files found by listing are skipped quietly unless they're .rtf or .itx
+    bool add_file(std::string const & name, bool listed) {
+        FileFormat format;
+        bool compressed;
+        if (!file_format(name, format, compressed)) {
+            if (!listed) std::cerr << name << ": not .rtf or .itx\n";
+            return listed;
+        }
+        long size = file_size(name);
+        if (size < 0) {
+            std::cerr << "can't open " << name << '\n';
+            return false;
+        }
+        std::unique_ptr<FileJob> job(new FileJob);
+        job->name = name;
+        job->format = format;
+        job->compressed = compressed;
+        job->size = size;
+        jobs.push_back(std::move(job));
+        return true;
+    }
+};
+
+class BatchCounter {
+public:
+    BatchCounter(WorkPool & work_pool, bool meters, long chunk_bytes)
+        : pool(work_pool), show_meters(meters), chunk_size(chunk_bytes) {}
+
+    void submit(FileJob & job) {
+        if (job.format == FileFormat::rtf) {
+            pool.submit([this, &job] { count_rtf(job); });
+        } else if (!job.compressed && job.size > chunk_size) {
+            pool.submit([this, &job] { split_itx(job); });
+        } else {
+            pool.submit([this, &job] { count_itx(job, 0, -1); });
+        }
+    }
+
+private:
+    WorkPool & pool;
+    bool show_meters;
+    long chunk_size;
+
+    void count_rtf(FileJob & job) {
+        std::string error;
+        auto in = open_input(job.name, error);
+        if (!in) return job.fail(error);
+        RtfParser<SbSlokaCounter> p;
+        p.GetOutputter().set_print_lines(false);
+        p.GetOutputter().set_show_meters(show_meters);
+        try {
+            Status ec = p.RtfParse(*in);
+            if (ec == Status::ReadError) return job.fail(in->error());
+            if (ec != Status::OK) return job.fail("error " + std::to_string(int(ec)) + " parsing RTF");
+        } catch (std::exception const & e) {
+            return job.fail(e.what());
+        }
+        CountTotals totals;
+        p.GetOutputter().add_totals_to(totals);
+        job.add(totals);
+    }
+
+    // [start, end) of the file; end -1 for the rest of it
+    void count_itx(FileJob & job, long start, long end) {
+        std::string error;
+        std::unique_ptr<ByteSource> in;
+        if (start == 0 && end < 0) {
+            in = open_input(job.name, error);
+            if (!in) return job.fail(error);
+        } else {
+            FILE * f = fopen(job.name.c_str(), "rb");
+            if (!f || fseek(f, start, SEEK_SET) != 0) {
+                if (f) fclose(f);
+                return job.fail("can't open " + job.name);
+            }
+            auto file = new FileSource(f, true);
+            if (end >= 0) file->set_limit(end - start);
+            in.reset(file);
+        }
+        SourceStreambuf buf(*in);
+        std::istream f(&buf);
+        SlokaCounter c;
+        c.set_print_lines(false);
+        c.set_show_meters(show_meters);
+        try {
+            c.count(f);
+        } catch (std::exception const & e) {
+            return job.fail(e.what());
+        }
+        if (!in->error().empty()) return job.fail(in->error());
+        CountTotals totals;
+        c.add_totals_to(totals);
+        job.add(totals);
+    }
+
+    // Cuts the file about every chunk_size bytes, each time at the next
+    // line where the chapter changes, and counts the pieces as tasks of
+    // their own; idle workers steal them.
+    void split_itx(FileJob & job) {
+        FILE * f = fopen(job.name.c_str(), "rb");
+        if (!f) return job.fail("can't open " + job.name);
+        std::vector<long> cuts{0};
+        for (long target = chunk_size; target < job.size; ) {
+            long cut = next_chapter_start(f, target);
+            if (cut < 0) break;
+            if (cut > cuts.back()) cuts.push_back(cut);
+            target = std::max(cut, target) + chunk_size;
+        }
+        fclose(f);
+        cuts.push_back(-1);
+        for (std::size_t i = 0; i + 1 < cuts.size(); ++i) {
+            long start = cuts[i], end = cuts[i + 1];
+            pool.submit([this, &job, start, end] { count_itx(job, start, end); });
+        }
+    }
+
+    // offset of the first line after from (at a line start) whose chapter
+    // differs from that of the numbered lines before it; -1 if none
+    static long next_chapter_start(FILE * f, long from) {
+        if (fseek(f, from - 1, SEEK_SET) != 0) return -1;
+        int ch;
+        while ((ch = getc(f)) != EOF && ch != '\n') {}
+        if (ch == EOF) return -1;
+        std::string line;
+        std::uint32_t seen = 0;
+        for (;;) {
+            long offset = ftell(f);
+            line.clear();
+            while ((ch = getc(f)) != EOF && ch != '\n') line += static_cast<char>(ch);
+            if (line.empty() && ch == EOF) return -1;
+            std::uint32_t chapter = SlokaCounter::line_chapter(line);
+            if (chapter != 0) {
+                if (seen != 0 && chapter != seen) return offset;
+                seen = chapter;
+            }
+        }
+    }
+};
+
+static char const usage[] =
+    "usage: sb-batch [--meters] [--format text|csv|ndjson] [--jobs N]"
+    " [--chunk-mb N] [--stats] [--stats-json FILE] DIR|FILE|PATTERN...\n";
+
+int main(int argc, char * argv[]) {
+    bool show_meters = false;
+    ReportFormat format = ReportFormat::text;
+    unsigned jobs = std::thread::hardware_concurrency();
+    long chunk_mb = 16;
+    bool stats = false;
+    char const * stats_json_name = nullptr;
+    Corpus corpus;
+    bool ok = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--meters") {
+            show_meters = true;
+        } else if (arg == "--format" && i + 1 < argc && parse_format(argv[i + 1], format)) {
+            ++i;
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            if (!parse_jobs(argv[++i], jobs)) {
+                std::cerr << "bad job count: " << argv[i] << '\n' << usage;
+                return 2;
+            }
+        } else if (arg == "--chunk-mb" && i + 1 < argc) {
+            chunk_mb = std::atol(argv[++i]);
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (arg == "--stats-json" && i + 1 < argc) {
+            stats_json_name = argv[++i];
+        } else if (arg.compare(0, 2, "--") == 0) {
+            std::cerr << "unknown option: " << arg << '\n';
+            return 1;
+        } else {
+            ok = corpus.add(arg) && ok;
+        }
+    }
+    if (corpus.jobs.empty()) {
+        std::cerr << usage;
+        return 1;
+    }
+
+    if (stats || stats_json_name) {
+        run_stats.start();
+    }
+
+    {
+        // largest first, so that small files fill in the gaps at the end
+        std::vector<FileJob *> order;
+        for (auto & job: corpus.jobs) order.push_back(job.get());
+        std::stable_sort(order.begin(), order.end(),
+            [](FileJob const * a, FileJob const * b) { return a->size > b->size; });
+        WorkPool pool(jobs);
+        BatchCounter counter(pool, show_meters, std::max(chunk_mb, 1L) << 20);
+        for (auto job: order) counter.submit(*job);
+        StatsIdle idle;
+        pool.wait();
+    }
+
+    ReportWriter writer(format);
+    CountTotals all;
+    int counted = 0;
+    for (auto & job: corpus.jobs) {
+        if (!job->error.empty()) {
+            std::cerr << job->name << ": " << job->error << '\n';
+            ok = false;
+            continue;
+        }
+        writer.file(job->name);
+        job->totals.print(writer, show_meters);
+        all.syllables += job->totals.syllables;
+        all.syllables_no_uvaca += job->totals.syllables_no_uvaca;
+        ++counted;
+    }
+    writer.files(counted);
+    writer.totals(all.syllables, all.syllables_no_uvaca);
+    writer.flush();
+    if (writer.failed()) {
+        std::cerr << "can't write the report\n";
+        ok = false;
+    }
+
+    return report_stats(stats, stats_json_name) && ok ? 0 : 1;
+}
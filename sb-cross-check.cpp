@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "input.h"
+#include "sb-itx-sloka-counter.h"
+#include "sb-sloka-counter.h"
+
+enum class Source { rtf, itx };
+
+struct SourcedRecord {
+    Source source;
+    VerseRecord verse;
+};
+
+// Records from both counting threads, handed over in batches
+// so that the lock is taken once per few hundred verses.
+class VerseQueue {
+public:
+    explicit VerseQueue(int producers) : producers_left(producers) {}
+
+    void push(std::vector<SourcedRecord> && batch) {
+        std::lock_guard<std::mutex> lock(mutex);
+        batches.push_back(std::move(batch));
+        ready.notify_one();
+    }
+
+    void producer_done() {
+        std::lock_guard<std::mutex> lock(mutex);
+        --producers_left;
+        ready.notify_one();
+    }
+
+    // false when all producers are done and nothing is left
+    bool pop(std::vector<SourcedRecord> & batch) {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return !batches.empty() || producers_left == 0; });
+        if (batches.empty()) return false;
+        batch = std::move(batches.front());
+        batches.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::vector<SourcedRecord>> batches;
+    int producers_left;
+};
+
+class BatchingSink {
+public:
+    BatchingSink(VerseQueue & queue, Source source) : queue_(queue), source_(source) {}
+
+    void operator()(VerseRecord const & verse) {
+        batch.push_back(SourcedRecord{source_, verse});
+        if (batch.size() >= batch_size) flush();
+    }
+
+    void flush() {
+        if (!batch.empty()) {
+            queue_.push(std::move(batch));
+            batch.clear();
+        }
+    }
+
+private:
+    static const std::size_t batch_size = 256;
+    VerseQueue & queue_;
+    Source source_;
+    std::vector<SourcedRecord> batch;
+};
+
+// Symmetric hash join on verse id. A verse waits in the table only until
+// its counterpart arrives, so the table holds the verses one side is ahead by
+// plus the coverage gaps. A "TEXTS a-b" record from sb.rtf collects the
+// itx verses a..b, whichever order they come in.
+class VerseJoin {
+public:
+    void add(SourcedRecord const & r) {
+        if (r.source == Source::rtf) {
+            add_rtf(r.verse);
+        } else {
+            add_itx(r.verse);
+        }
+    }
+
+    // everything still pending has no counterpart
+    void finish() {
+        for (auto & pair: pending) {
+            Entry & e = pair.second;
+            if (e.have_rtf) {
+                report.push_back(Report{pair.first, "only in rtf", e, e.last_text});
+            } else {
+                report.push_back(Report{pair.first, "only in itx", e, e.last_text});
+            }
+        }
+        pending.clear();
+        std::sort(report.begin(), report.end(),
+            [](Report const & a, Report const & b) { return a.id < b.id; });
+    }
+
+    int print() {
+        for (auto & r: report) {
+            std::cout << verse_id_to_string(r.id);
+            if (r.last_text != verse_text(r.id)) {
+                std::cout << '-' << r.last_text;
+            }
+            std::cout << ": " << r.what << ": rtf " << r.entry.rtf.syllables
+                << " (" << r.entry.rtf.syllables_no_uvaca << ")"
+                << ", itx " << r.entry.itx.syllables
+                << " (" << r.entry.itx.syllables_no_uvaca << ")\n";
+        }
+        std::cout << "verses compared: " << compared << '\n';
+        std::cout << "mismatches and gaps: " << report.size() << '\n';
+        return report.empty() ? 0 : 1;
+    }
+
+private:
+    struct Totals {
+        int syllables = 0;
+        int syllables_no_uvaca = 0;
+    };
+    struct Entry {
+        bool have_rtf = false;
+        int last_text = 0;
+        int itx_needed = 1;
+        int itx_seen = 0;
+        Totals rtf;
+        Totals itx;
+    };
+    struct Report {
+        std::uint32_t id;
+        char const * what;
+        Entry entry;
+        int last_text;
+    };
+
+    std::unordered_map<std::uint32_t, Entry> pending;
+    // itx verse id -> id of the rtf range it belongs to
+    std::unordered_map<std::uint32_t, std::uint32_t> range_head;
+    std::vector<Report> report;
+    int compared = 0;
+
+    void add_rtf(VerseRecord const & v) {
+        Entry & e = pending[v.id];
+        e.have_rtf = true;
+        e.last_text = v.last_text;
+        e.rtf.syllables = v.syllables;
+        e.rtf.syllables_no_uvaca = v.syllables_no_uvaca;
+        int first = verse_text(v.id);
+        e.itx_needed = std::max(1, v.last_text - first + 1);
+        for (int text = first + 1; text <= v.last_text; ++text) {
+            auto id = with_verse_text(v.id, text);
+            auto it = pending.find(id);
+            if (it != pending.end() && !it->second.have_rtf) {
+                // itx was ahead: fold it into the range
+                e.itx.syllables += it->second.itx.syllables;
+                e.itx.syllables_no_uvaca += it->second.itx.syllables_no_uvaca;
+                e.itx_seen += it->second.itx_seen;
+                pending.erase(it);
+            } else {
+                range_head[id] = v.id;
+            }
+        }
+        complete(v.id);
+    }
+
+    void add_itx(VerseRecord const & v) {
+        auto id = v.id;
+        auto head = range_head.find(id);
+        if (head != range_head.end()) {
+            id = head->second;
+            range_head.erase(head);
+        }
+        Entry & e = pending[id];
+        if (!e.have_rtf) e.last_text = v.last_text;
+        e.itx.syllables += v.syllables;
+        e.itx.syllables_no_uvaca += v.syllables_no_uvaca;
+        ++e.itx_seen;
+        complete(id);
+    }
+
+    void complete(std::uint32_t id) {
+        auto it = pending.find(id);
+        Entry & e = it->second;
+        if (!e.have_rtf || e.itx_seen < e.itx_needed) return;
+        ++compared;
+        if (e.rtf.syllables != e.itx.syllables
+                || e.rtf.syllables_no_uvaca != e.itx.syllables_no_uvaca) {
+            report.push_back(Report{id, "mismatch", e, e.last_text});
+        }
+        pending.erase(it);
+    }
+};
+
+int main(int argc, char * argv[]) {
+    std::string rtf_name = argc > 1 ? argv[1] : "sb.rtf";
+    std::string itx_name = argc > 2 ? argv[2] : "bhagpur.itx";
+
+    std::string open_error;
+    auto rtf = open_input(rtf_name, open_error);
+    auto itx_source = rtf ? open_input(itx_name, open_error) : nullptr;
+    if (!rtf || !itx_source) {
+        std::cerr << open_error << '\n';
+        return 1;
+    }
+    SourceStreambuf itx_buf(*itx_source);
+    std::istream itx(&itx_buf);
+
+    VerseQueue queue(2);
+    std::string rtf_error, itx_error;
+
+    std::thread rtf_thread([&] {
+        BatchingSink sink(queue, Source::rtf);
+        RtfParser<SbSlokaCounter> p;
+        p.GetOutputter().set_print_lines(false);
+        p.GetOutputter().set_verse_sink(std::ref(sink));
+        try {
+            Status ec = p.RtfParse(*rtf);
+            if (ec == Status::ReadError) {
+                rtf_error = rtf_name + ": " + rtf->error();
+            } else if (ec != Status::OK) {
+                rtf_error = "error " + std::to_string(int(ec)) + " parsing RTF";
+            }
+        } catch (std::exception const & e) {
+            rtf_error = e.what();
+        }
+        sink.flush();
+        queue.producer_done();
+    });
+
+    std::thread itx_thread([&] {
+        BatchingSink sink(queue, Source::itx);
+        SlokaCounter c;
+        c.set_print_lines(false);
+        c.set_verse_sink(std::ref(sink));
+        try {
+            c.count(itx);
+            if (!itx_source->error().empty()) {
+                itx_error = itx_name + ": " + itx_source->error();
+            }
+        } catch (std::exception const & e) {
+            itx_error = e.what();
+        }
+        sink.flush();
+        queue.producer_done();
+    });
+
+    VerseJoin join;
+    std::vector<SourcedRecord> batch;
+    while (queue.pop(batch)) {
+        for (auto & r: batch) {
+            join.add(r);
+        }
+    }
+    rtf_thread.join();
+    itx_thread.join();
+    for (auto & error: {rtf_error, itx_error}) {
+        if (!error.empty()) {
+            std::cerr << error << '\n';
+            return 1;
+        }
+    }
+
+    join.finish();
+    return join.print();
+}
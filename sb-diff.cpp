@@ -0,0 +1,314 @@
+// Verse-level diff of two editions of the corpus.
+//
+//   sb-diff OLD NEW
+//
+// OLD and NEW are in the same format: sb.rtf-style RTF, or ITRANS when the
+// name contains ".itx" (either plain, .gz or .zst). Both are counted at the
+// same time, each on its own thread, and reduced to per-verse records (id,
+// text hash, syllables) that are merged by verse id as they arrive. Prints
+// the verses added, removed or changed, the chapters whose totals moved and
+// the overall totals. Exits with 1 if the editions differ.
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "input.h"
+#include "sb-itx-sloka-counter.h"
+#include "sb-sloka-counter.h"
+
+// Records of one edition, handed over in batches. The counting thread
+// waits when it is max_batches ahead, so neither edition gets far ahead of
+// the merge.
+class RecordQueue {
+public:
+    void push(std::vector<VerseRecord> && batch) {
+        std::unique_lock<std::mutex> lock(mutex);
+        space.wait(lock, [this] { return batches.size() < max_batches; });
+        batches.push_back(std::move(batch));
+        ready.notify_one();
+    }
+
+    void producer_done() {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        ready.notify_one();
+    }
+
+    // false when the producer is done and nothing is left
+    bool pop(std::vector<VerseRecord> & batch) {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return !batches.empty() || done; });
+        if (batches.empty()) return false;
+        batch = std::move(batches.front());
+        batches.pop_front();
+        space.notify_one();
+        return true;
+    }
+
+private:
+    static const std::size_t max_batches = 8;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::condition_variable space;
+    std::deque<std::vector<VerseRecord>> batches;
+    bool done = false;
+};
+
+class BatchingSink {
+public:
+    explicit BatchingSink(RecordQueue & queue) : queue_(queue) {}
+
+    void operator()(VerseRecord const & verse) {
+        batch.push_back(verse);
+        if (batch.size() >= batch_size) flush();
+    }
+
+    void flush() {
+        if (!batch.empty()) {
+            queue_.push(std::move(batch));
+            batch.clear();
+        }
+    }
+
+private:
+    static const std::size_t batch_size = 256;
+    RecordQueue & queue_;
+    std::vector<VerseRecord> batch;
+};
+
+// Counts one edition into queue; an empty string or the error.
+static std::string count_edition(std::string const & name, RecordQueue & queue) {
+    std::string error;
+    BatchingSink sink(queue);
+    auto in = open_input(name, error);
+    if (in) {
+        try {
+            if (name.find(".itx") != std::string::npos) {
+                SourceStreambuf buf(*in);
+                std::istream f(&buf);
+                SlokaCounter c;
+                c.set_print_lines(false);
+                c.set_verse_sink(std::ref(sink));
+                c.count(f);
+                if (!in->error().empty()) error = name + ": " + in->error();
+            } else {
+                RtfParser<SbSlokaCounter> p;
+                p.GetOutputter().set_print_lines(false);
+                p.GetOutputter().set_verse_sink(std::ref(sink));
+                Status ec = p.RtfParse(*in);
+                if (ec == Status::ReadError) {
+                    error = name + ": " + in->error();
+                } else if (ec != Status::OK) {
+                    error = name + ": error " + std::to_string(int(ec)) + " parsing RTF";
+                }
+            }
+        } catch (std::exception const & e) {
+            error = name + ": " + e.what();
+        }
+    }
+    sink.flush();
+    queue.producer_done();
+    return error;
+}
+
+enum Side { old_side, new_side };
+
+enum class Change { changed, added, removed };
+
+// Symmetric hash join on verse id. Records wait in pending only until the
+// other edition's record for the same verse arrives; with both editions
+// merged in id order that is the verses one side is briefly ahead by, plus
+// the verses that are really added or removed.
+class EditionDiff {
+public:
+    void add(Side side, VerseRecord const & r) {
+        auto & totals = chapter_totals[r.id >> 16];
+        totals[side].syllables += r.syllables;
+        totals[side].syllables_no_uvaca += r.syllables_no_uvaca;
+        all[side].syllables += r.syllables;
+        all[side].syllables_no_uvaca += r.syllables_no_uvaca;
+
+        auto & other = pending[1 - side];
+        auto it = other.find(r.id);
+        if (it != other.end()) {
+            VerseRecord const & o = side == old_side ? r : it->second;
+            VerseRecord const & n = side == old_side ? it->second : r;
+            ++compared;
+            if (o.text_hash != n.text_hash || o.syllables != n.syllables
+                    || o.syllables_no_uvaca != n.syllables_no_uvaca || o.last_text != n.last_text) {
+                report.push_back(Report{Change::changed, o, n});
+            }
+            other.erase(it);
+            return;
+        }
+        auto inserted = pending[side].emplace(r.id, r);
+        if (!inserted.second) {
+            // the same id twice in one edition before the other has it
+            unmatched(side, inserted.first->second);
+            inserted.first->second = r;
+        }
+    }
+
+    // everything still pending is only in one edition
+    void finish() {
+        for (int side = 0; side < 2; ++side) {
+            for (auto & pair: pending[side]) unmatched(static_cast<Side>(side), pair.second);
+            pending[side].clear();
+        }
+        std::stable_sort(report.begin(), report.end(), [](Report const & a, Report const & b) {
+            return a.verse().id < b.verse().id;
+        });
+    }
+
+    int print() const {
+        for (auto & r: report) {
+            VerseRecord const & v = r.verse();
+            std::cout << verse_id_to_string(v.id);
+            if (v.last_text != verse_text(v.id)) std::cout << '-' << v.last_text;
+            if (r.change == Change::added) {
+                std::cout << ": added: " << r.now.syllables << " (" << r.now.syllables_no_uvaca << ")";
+            } else if (r.change == Change::removed) {
+                std::cout << ": removed: " << r.was.syllables << " (" << r.was.syllables_no_uvaca << ")";
+            } else if (r.was.syllables == r.now.syllables && r.was.syllables_no_uvaca == r.now.syllables_no_uvaca) {
+                std::cout << ": changed: text only, " << r.now.syllables << " (" << r.now.syllables_no_uvaca << ")";
+            } else {
+                std::cout << ": changed: " << r.was.syllables << " (" << r.was.syllables_no_uvaca << ") -> "
+                    << r.now.syllables << " (" << r.now.syllables_no_uvaca << ")";
+            }
+            std::cout << '\n';
+        }
+        for (auto & pair: chapter_totals) {
+            auto & t = pair.second;
+            if (t[old_side].syllables == t[new_side].syllables) continue;
+            char label[16];
+            snprintf(label, sizeof(label), "%02u.%02u", pair.first >> 8, pair.first & 0xff);
+            std::cout << "chapter " << label << ": " << delta(t[old_side].syllables, t[new_side].syllables) << '\n';
+        }
+        std::cout << "total syllables: " << delta(all[old_side].syllables, all[new_side].syllables) << '\n';
+        std::cout << "total syllables (no uvaaca): "
+            << delta(all[old_side].syllables_no_uvaca, all[new_side].syllables_no_uvaca) << '\n';
+        std::cout << "verses compared: " << compared << '\n';
+        std::cout << "differences: " << report.size() << '\n';
+        return report.empty() ? 0 : 1;
+    }
+
+private:
+    struct Totals {
+        long syllables = 0;
+        long syllables_no_uvaca = 0;
+    };
+    struct Report {
+        Change change;
+        VerseRecord was;
+        VerseRecord now;
+
+        VerseRecord const & verse() const { return change == Change::added ? now : was; }
+    };
+
+    std::unordered_map<std::uint32_t, VerseRecord> pending[2];
+    // canto << 8 | chapter -> totals of both editions
+    std::map<std::uint32_t, std::array<Totals, 2>> chapter_totals;
+    std::array<Totals, 2> all;
+    std::vector<Report> report;
+    long compared = 0;
+
+    void unmatched(Side side, VerseRecord const & r) {
+        if (side == old_side) {
+            report.push_back(Report{Change::removed, r, VerseRecord{}});
+        } else {
+            report.push_back(Report{Change::added, VerseRecord{}, r});
+        }
+    }
+
+    static std::string delta(long was, long now) {
+        std::string s = std::to_string(was);
+        if (now != was) {
+            s += " -> " + std::to_string(now) + " (" + (now > was ? "+" : "") + std::to_string(now - was) + ")";
+        }
+        return s;
+    }
+};
+
+// The next record of one edition, pulled from its queue a batch at a time.
+class Cursor {
+public:
+    explicit Cursor(RecordQueue & queue) : queue_(queue) {}
+
+    // false at the end of the edition
+    bool fill() {
+        while (pos == batch.size()) {
+            if (!queue_.pop(batch)) return false;
+            pos = 0;
+        }
+        return true;
+    }
+
+    VerseRecord const & head() const { return batch[pos]; }
+    void next() { ++pos; }
+
+private:
+    RecordQueue & queue_;
+    std::vector<VerseRecord> batch;
+    std::size_t pos = 0;
+};
+
+int main(int argc, char * argv[]) {
+    if (argc != 3) {
+        std::cerr << "usage: sb-diff OLD NEW\n";
+        return 1;
+    }
+    std::string old_name = argv[1];
+    std::string new_name = argv[2];
+    if ((old_name.find(".itx") == std::string::npos) != (new_name.find(".itx") == std::string::npos)) {
+        std::cerr << "both editions must be RTF or both ITRANS\n";
+        return 1;
+    }
+
+    RecordQueue old_queue, new_queue;
+    std::string old_error, new_error;
+    std::thread old_thread([&] { old_error = count_edition(old_name, old_queue); });
+    std::thread new_thread([&] { new_error = count_edition(new_name, new_queue); });
+
+    // merge by verse id, so both editions are consumed at the same pace;
+    // equal ids go in together, which keeps repeated ids (4.29.46-47 in
+    // bhagpur.itx) paired in order
+    EditionDiff diff;
+    Cursor old_cursor(old_queue), new_cursor(new_queue);
+    for (;;) {
+        bool have_old = old_cursor.fill();
+        bool have_new = new_cursor.fill();
+        if (!have_old && !have_new) break;
+        bool take_old = have_old && (!have_new || old_cursor.head().id <= new_cursor.head().id);
+        bool take_new = have_new && (!have_old || new_cursor.head().id <= old_cursor.head().id);
+        if (take_old) {
+            diff.add(old_side, old_cursor.head());
+            old_cursor.next();
+        }
+        if (take_new) {
+            diff.add(new_side, new_cursor.head());
+            new_cursor.next();
+        }
+    }
+    old_thread.join();
+    new_thread.join();
+    for (auto & error: {old_error, new_error}) {
+        if (!error.empty()) {
+            std::cerr << error << '\n';
+            return 2;
+        }
+    }
+
+    diff.finish();
+    return diff.print();
+}
@@ -1,223 +1,150 @@
-#include <fstream>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
-#include <map>
-#include <regex>
-
-class SlokaCounter {
-public:
-    void do_counting(std::istream & f) {
-        std::string line;
-        while (std::getline(f, line)) {
-            process_line(line);
+#include <string>
+#include <vector>
+
+#include "input.h"
+#include "repeats.h"
+#include "sb-itx-sloka-counter.h"
+#include "stats.h"
+#include "verse-columns.h"
+#include "verse-index.h"
+#include "word-stats.h"
+
+// sb-itx-sloka-counter [--utf8] [--meters] [--totals-only] [--format F] [--emit-binary FILE]
+//                      [--index FILE] [--word-stats K] [--repeats] [--unique-totals]
+//                      [--validate-only] [--stats] [--stats-json FILE] [INPUT]
+// INPUT defaults to bhagpur.itx. With --utf8 the verse text is IAST or
+// Devanagari in UTF-8 instead of ITRANS, in the same numbered lines.
+// --totals-only prints just the chapter and overall totals, skipping the
+// transliteration and formatting of every line. --index writes a search
+// index over the verse text for sb-search. --word-stats adds word counts
+// per chapter and overall after the totals, with the K most frequent words.
+// --repeats lists repeated and nearly repeated lines; --unique-totals adds
+// totals that count each repeated line once. --validate-only just checks
+// the verse numbering and lists every problem found, exiting with 1 if
+// there are any.
+int main(int argc, char * argv[]) {
+    bool show_meters = false;
+    bool totals_only = false;
+    TextEncoding encoding = TextEncoding::itrans;
+    std::string input_name;
+    char const * binary_name = nullptr;
+    char const * index_name = nullptr;
+    long word_stats_top = -1;
+    bool repeats = false;
+    bool unique_totals = false;
+    bool validate_only = false;
+    ReportFormat format = ReportFormat::text;
+    bool stats = false;
+    char const * stats_json_name = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--meters") {
+            show_meters = true;
+        } else if (std::string(argv[i]) == "--totals-only") {
+            totals_only = true;
+        } else if (std::string(argv[i]) == "--emit-binary" && i + 1 < argc) {
+            binary_name = argv[++i];
+        } else if (std::string(argv[i]) == "--index" && i + 1 < argc) {
+            index_name = argv[++i];
+        } else if (std::string(argv[i]) == "--word-stats" && i + 1 < argc) {
+            word_stats_top = std::atol(argv[++i]);
+        } else if (std::string(argv[i]) == "--repeats") {
+            repeats = true;
+        } else if (std::string(argv[i]) == "--unique-totals") {
+            unique_totals = true;
+        } else if (std::string(argv[i]) == "--validate-only") {
+            validate_only = true;
+        } else if (std::string(argv[i]) == "--format" && i + 1 < argc
+                   && parse_format(argv[i + 1], format)) {
+            ++i;
+        } else if (std::string(argv[i]) == "--stats") {
+            stats = true;
+        } else if (std::string(argv[i]) == "--stats-json" && i + 1 < argc) {
+            stats_json_name = argv[++i];
+        } else if (std::string(argv[i]) == "--utf8") {
+            encoding = TextEncoding::utf8;
+        } else if (argv[i][0] != '-' && input_name.empty()) {
+            input_name = argv[i];
+        } else {
+            std::cerr << "unknown option: " << argv[i] << '\n';
+            return 1;
         }
+    }
 
-        print_total_by_chapter();
-
-        std::cout << "total syllables: " << total_syllables << '\n';
-        std::cout << "total syllables (no uvaaca): " << total_syllables_no_uvaca << '\n';
+    std::string error;
+    auto in = input_name.empty() ? open_input_or_compressed("bhagpur.itx", error)
+                                 : open_input(input_name, error);
+    if (!in) {
+        std::cerr << error << '\n';
+        return 1;
     }
+    SourceStreambuf buf(*in);
+    std::istream f(&buf);
 
-private:
-    std::string itx_to_unicode(std::string const &s) {
-        std::string u;
-        auto size = s.size();
-        for (decltype(size) i=0; i < size; ++i) {
-            switch (static_cast<unsigned char>(s[i])) {
-                case 'M': u += "ṁ"; break;
-                case 'A': u += "ā"; break;
-                case 'R':
-                    if (i+2 < size && s[i+1] == '^' && s[i+2] == 'i') {
-                        i += 2;
-                        u += "ṛ";
-                    } else if (i+2 < size && s[i+1] == '^' && s[i+2] == 'I') {
-                        i += 2;
-                        u += "ṝ";
-                    }
-                    break;
-                case 'L':
-                    if (i+2 < size && s[i+1] == '^' && s[i+2] == 'i') {
-                        i += 2;
-                        u += "ḷ";
-                    }
-                    break;
-                case 'S':
-                    if (i+1 < size && s[i+1] == 'h') {
-                        i += 1;
-                        u += "ś";
-                    }
-                    break;
-                case 'I': u += "ī"; break;
-                case 'N': u += "ṇ"; break;
-                case '~':
-                    if (i+1 < size && s[i+1] == 'n') {
-                        i += 1;
-                        u += "ñ";
-                    } else if (i+1 < size && s[i+1] == 'N') {
-                        i += 1;
-                        u += "ṅ";
-                    }
-                    break;
-                case 's':
-                    if (i+1 < size && s[i+1] == 'h') {
-                        i += 1;
-                        u += "ṣ";
-                    } else {
-                        u += 's';
-                    }
-                    break;
-                case 'D': u += "ḍ"; break;
-                case 'T': u += "ṭ"; break;
-                case 'H': u += "ḥ"; break;
-                case 'U': u += "ū"; break;
-                case '.':
-                    if (i+1 < size && s[i+1] == 'a') {
-                        i += 1;
-                        u += " '";
-                    }
-                    break;
-                case 'c':
-                    if (i+1 < size && s[i+1] == 'h') {
-                        i += 1;
-                        u += 'c';
-                    }
-                    break;
-                case 'C':
-                    if (i+1 < size && s[i+1] == 'h') {
-                        i += 1;
-                        u += "ch";
-                    }
-                    break;
-                default: u += s[i];
-            }
-        }
-        return u;
+    if (stats || stats_json_name) {
+        run_stats.start();
     }
 
-    int syllables(std::string const & s) {
-        int syllables_count = 0;
-        auto size = s.size();
-        for (unsigned i=0; i<size; ++i) {
-            switch (static_cast<unsigned char>(s[i])) {
-                // a is handled below because of ai and au
-                case 'A': // aa
-                case 'i':  // i
-                case 'I': // ii
-                case 'u':  // u
-                case 'U': // uu
-                case 'e':  // e
-                case 'o':  // o
-                    ++syllables_count;
-                    break;
-                case 'a':  // a
-                    if (i+1 < size && (s[i+1] == 'i' || s[i+1] == 'u')) {
-                        ++i;
-                    }
-                    ++syllables_count;
-                    break;
-                case 'R': // R, RR
-                case 'L': // L, (theoretically) LL
-                    if (i+1 < size && (s[i+1] == 'i' || s[i+1] == 'I')) {
-                        i += 2;
-                        ++syllables_count;
-                    }
-                    break;
-                case '.':
-                    // '.a' is avagraha
-                    if (i+1 < size && s[i+1] == 'a') {
-                        i += 1;
-                    }
-                    break;
-                default:
-                    break;
-            }
+    if (validate_only) {
+        SlokaCounter c;
+        c.set_validate_only(true);
+        c.count(f);
+        if (!in->error().empty()) {
+            std::cerr << (input_name.empty() ? "bhagpur.itx" : input_name) << ": " << in->error() << '\n';
+            return 1;
         }
-        return syllables_count;
+        bool valid = print_problems(c.problems());
+        return report_stats(stats, stats_json_name) && valid ? 0 : 1;
     }
 
-    bool ends_with(std::string const & subject, std::string const & with) {
-        auto subject_size = subject.size();
-        auto with_size = with.size();
-        if (subject_size < with_size) return false;
-        auto start = subject_size - with_size;
-        return (subject.compare(start, with_size, with) == 0);
+    SlokaCounter c;
+    c.set_show_meters(show_meters);
+    c.set_print_lines(!totals_only);
+    c.set_encoding(encoding);
+    c.set_format(format);
+    VerseColumnsWriter columns;
+    VerseIndexWriter index;
+    WordStats word_stats;
+    RepeatFinder repeat_finder;
+    if (binary_name || index_name || word_stats_top >= 0 || repeats || unique_totals) {
+        c.set_line_sink([&](std::uint32_t id, int syllables, bool uvaca, std::string const & text) {
+            if (binary_name) columns.add(id, syllables, uvaca, text);
+            if (index_name) index.add(id, text);
+            if (word_stats_top >= 0) word_stats.add_line(id, text);
+            if (repeats || unique_totals) repeat_finder.add_line(id, syllables, uvaca, text);
+        });
     }
-
-    void print_total_by_chapter() {
-        for (auto & pair: total_by_chapter) {
-            std::cout << "chapter " << pair.first << ": " << pair.second << '\n';
-        }
+    try {
+        c.do_counting(f);
+    } catch (std::exception const & e) {
+        c.flush();
+        std::cerr << e.what() << '\n';
+        return 1;
     }
-
-    // true if this is "... uvaaca" line
-    bool uvaca(std::string const & line) {
-        static std::vector<std::string> uvacas = {
-            "ovAcha", // for rajovaaca, brahmovaaca, etc.
-            "uvAcha", // for generic singular "xxx uvaaca"
-            "UchuH", // for generic plural "xxx uucuH"
-        };
-        return std::any_of(uvacas.begin(), uvacas.end(),
-            [&](std::string const & u) { return ends_with(line, u); });
+    if (!in->error().empty()) {
+        std::cerr << (input_name.empty() ? "bhagpur.itx" : input_name) << ": " << in->error() << '\n';
+        return 1;
     }
-
-    void process_line(std::string & line) {
-        std::smatch match;
-        static std::regex r(R"RE((\d\d)(\d\d)(\d\d\d)(\d) (.*?)(?: *#|$))RE");
-        std::string & text = line;
-        if (std::regex_search(line, match, r)) {
-            canto = std::stoi(match.str(1));
-            chapter = std::stoi(match.str(2));
-            text_num = std::stoi(match.str(3));
-            line_num = std::stoi(match.str(4));
-            text = match.str(5);
-        } else {
-            if (canto == 12 && chapter == 13 && text_num == 23 && line.size() >= 1 && line[0] == ' ') {
-                // skip the rest of the lines, they are not part of Bhagavatam per se
-                canto = 0;
-            }
-        }
-
-        if (canto == 0) return; // it means current line is not part of Bhagavatam
-
-        auto syllables_count = syllables(text);
-        total_syllables += syllables_count;
-
-        char canto_chapter[20];
-        snprintf(canto_chapter, 20, "%02d.%02d", canto, chapter);
-        char canto_dot_x[20];
-        snprintf(canto_dot_x, 20, "%02d.x", canto);
-        total_by_chapter[canto_chapter] += syllables_count;
-        total_by_chapter[canto_dot_x] += syllables_count;
-
-        bool is_uvaca = (line_num == 0); // uvaca(text);
-        if (!is_uvaca) {
-            total_syllables_no_uvaca += syllables_count;
-        }
-        if (is_uvaca != (line_num == 0)) {
-            std::cerr << "mismatch of uvaca: is_uvaca=" << is_uvaca << ", line_num=" << line_num << '\n';
-            std::exit(1);
-        }
-
-        std::cout << canto << '.' << chapter << '.' << text_num
-            << "(" << syllables_count << (is_uvaca ? "'" : "") << "): "
-            << itx_to_unicode(text) << '\n';
+    if (word_stats_top >= 0) {
+        word_stats.write(stdout, static_cast<std::size_t>(word_stats_top));
     }
+    if (unique_totals) repeat_finder.write_unique_totals(stdout);
+    if (repeats) repeat_finder.write(stdout);
 
-    int total_syllables = 0;
-    int total_syllables_no_uvaca = 0;
-    int canto = 0;
-    int chapter = 0;
-    int text_num = 0;
-    int line_num = 0;
-    std::map<std::string, int> total_by_chapter;
-};
-
-int main() {
-    std::ifstream f("bhagpur.itx");
-    if (!f) {
-        std::cerr << "can't open bhagpur.itx";
+    if (binary_name && !columns.write(binary_name)) {
+        std::cerr << "can't write " << binary_name << '\n';
+        return 1;
+    }
+    if (index_name && !index.write(index_name)) {
+        std::cerr << "can't write " << index_name << '\n';
+        return 1;
+    }
+    if (c.output_failed()) {
+        std::cerr << "can't write the report\n";
         return 1;
     }
 
-    SlokaCounter c;
-    c.do_counting(f);
+    return report_stats(stats, stats_json_name) ? 0 : 1;
 }
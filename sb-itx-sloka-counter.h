@@ -0,0 +1,179 @@
+#ifndef sb_itx_sloka_counter_h
+#define sb_itx_sloka_counter_h
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "encodings.h"
+#include "probes.h"
+#include "sloka-counter-base.h"
+#include "stats.h"
+#include "verse.h"
+
+// How the verse text of the lines is written: ITRANS, as in bhagpur.itx, or
+// UTF-8 IAST/Devanagari in the same line layout.
+enum class TextEncoding { itrans, utf8 };
+
+class SlokaCounter : public SlokaCounterBase {
+public:
+    void set_encoding(TextEncoding text_encoding) {
+        encoding = text_encoding;
+    }
+
+    // Only check the line numbers, collecting every numbering problem in
+    // problems(); no syllables are counted and nothing is printed.
+    void set_validate_only(bool validate) {
+        validate_only = validate;
+        verse_range.collect_problems(validate);
+    }
+
+    std::vector<std::string> const & problems() const {
+        return verse_range.problems();
+    }
+
+    void do_counting(std::istream & f) {
+        count(f);
+        print_totals();
+    }
+
+    void count(std::istream & f) {
+        StatsStage stage(Stage::tokenize);
+        std::string line;
+        line.reserve(line_capacity);
+        while (std::getline(f, line)) count_line(line);
+        finish();
+    }
+
+    // The same a line at a time, for readers that pull: count_line for
+    // every line, without its newline, then finish.
+    void count_line(std::string & line) {
+        stats_count(StatCounter::bytes, line.size() + 1);
+        ++line_count;
+        SB_PROBE2(line_start, line_count, input_offset);
+        input_offset += static_cast<long>(line.size()) + 1;
+        int syllables_count = process_line(line);
+        SB_PROBE2(line_end, canto != 0 ? verse_totals.id : 0, syllables_count);
+    }
+
+    void finish() {
+        end_verse();
+    }
+
+    // Canto and chapter of a numbered line, packed as in verse.h with text 0;
+    // 0 for other lines. Counting restarts cleanly at a line where this
+    // changes, so large files can be counted in chunks split there.
+    static std::uint32_t line_chapter(std::string const & line) {
+        std::size_t pos, text_start, text_end;
+        if (!find_numbered_text(line, pos, text_start, text_end)) return 0;
+        return pack_verse_id(digits(line.data() + pos, 2), digits(line.data() + pos + 2, 2), 0);
+    }
+
+private:
+    static int digits(char const * p, int n) {
+        int value = 0;
+        for (int i = 0; i < n; ++i) value = value * 10 + (p[i] - '0');
+        return value;
+    }
+
+    // Finds "CCcctttl text  # comment" (canto, chapter, text, line number)
+    // anywhere in the line, like the regex (\d\d)(\d\d)(\d\d\d)(\d) (.*?)(?: *#|$).
+    // pos is where the digits start, [text_start, text_end) the text.
+    // The first such number is the one before the first space that has
+    // eight digits in front of it, so this jumps from space to space with
+    // memchr (vectorized in the C library) rather than trying every offset.
+    static bool find_numbered_text(std::string const & line, std::size_t & pos,
+                                   std::size_t & text_start, std::size_t & text_end) {
+        auto size = line.size();
+        char const * data = line.data();
+        for (std::size_t space = 8; space < size; ++space) {
+            auto found = static_cast<char const *>(std::memchr(data + space, ' ', size - space));
+            if (!found) return false;
+            space = static_cast<std::size_t>(found - data);
+            std::size_t i = space - 8;
+            std::size_t n = 0;
+            while (n < 8 && line[i + n] >= '0' && line[i + n] <= '9') ++n;
+            if (n < 8) continue;
+            pos = i;
+            text_start = i + 9;
+            text_end = line.find('#', text_start);
+            if (text_end == std::string::npos) {
+                text_end = size;
+            } else {
+                while (text_end > text_start && line[text_end - 1] == ' ') --text_end;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void enter_chapter() {
+        current_chapter = pack_verse_id(canto, chapter, 0);
+        SB_PROBE2(chapter, canto, chapter);
+        SlokaCounterBase::enter_chapter(std::to_string(canto), std::to_string(chapter));
+    }
+
+    // the new verse's numbers against the previous verse's, as sb.rtf's headings are
+    void check_numbers() {
+        verse_range.start_chapter(std::to_string(canto), std::to_string(chapter));
+        verse_range.start_text_range(std::to_string(text_num));
+    }
+
+    // syllables in the line, 0 if it isn't part of the Bhagavatam
+    int process_line(std::string & line) {
+        stats_count(StatCounter::lines);
+        StatsStage stage(Stage::classify);
+        std::string & text = line;
+        std::size_t pos, text_start, text_end;
+        if (find_numbered_text(line, pos, text_start, text_end)) {
+            char const * p = line.data() + pos;
+            canto = digits(p, 2);
+            chapter = digits(p + 2, 2);
+            text_num = digits(p + 4, 3);
+            line_num = digits(p + 7, 1);
+            text.erase(text_end);
+            text.erase(0, text_start);
+            if (pack_verse_id(canto, chapter, 0) != current_chapter) {
+                enter_chapter();
+            }
+            auto id = pack_verse_id(canto, chapter, text_num);
+            if (id != verse_totals.id) {
+                end_verse();
+                verse_totals.id = id;
+                verse_totals.last_text = text_num;
+                SB_PROBE1(verse_start, id);
+                if (validate_only) check_numbers();
+            }
+        } else {
+            if (canto == 12 && chapter == 13 && text_num == 23 && line.size() >= 1 && line[0] == ' ') {
+                // skip the rest of the lines, they are not part of Bhagavatam per se
+                end_verse();
+                canto = 0;
+            }
+        }
+
+        if (canto == 0) return 0; // it means current line is not part of Bhagavatam
+        if (validate_only) return 0;
+
+        bool uvaca = line_num == 0;     // speakers' lines are numbered 0
+        if (encoding == TextEncoding::utf8) {
+            return count_verse_line<Utf8Encoding>(text, uvaca, verse_totals.id, verse_totals.id);
+        }
+        return count_verse_line<ItransEncoding>(text, uvaca, verse_totals.id, verse_totals.id);
+    }
+
+    int canto = 0;
+    int chapter = 0;
+    int text_num = 0;
+    int line_num = 0;
+    long line_count = 0;
+    long input_offset = 0;
+    TextEncoding encoding = TextEncoding::itrans;
+    std::uint32_t current_chapter = 0;
+    bool validate_only = false;
+    VerseRange verse_range;         // only kept up to date when validating
+};
+
+#endif
+
@@ -0,0 +1,168 @@
+// Looks up words or phrases in an index written by the counters' --index.
+//
+//   sb-search [--count] [--time] [--fuzzy D [--top K] [--jobs N]] INDEX WORDS...
+//
+// WORDS are joined into one phrase and matched in folded form (see
+// verse-index.h), so diacritics, case, spacing and punctuation don't matter.
+// Prints each matching verse as "canto.chapter.text: line / line...",
+// or just the number of matches with --count. --time reports the query
+// time on stderr.
+//
+// --fuzzy finds verses containing the phrase with at most D edits instead,
+// scanning the chapters on N threads (default: all cores). It prints the K
+// closest (default 10) as "canto.chapter.text (distance): line", with the
+// line where the match ends; the phrase can be at most 64 folded letters.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fuzzy-match.h"
+#include "verse-index.h"
+#include "verse.h"
+#include "work-pool.h"
+
+struct FuzzyHit {
+    int distance;
+    std::size_t doc;
+    std::size_t end;    // offset in the folded verse just past the match
+
+    bool operator<(FuzzyHit const & other) const {
+        return distance != other.distance ? distance < other.distance : doc < other.doc;
+    }
+};
+
+// Every verse within max_distance of the phrase, closest first, one task
+// per chapter.
+static std::vector<FuzzyHit> fuzzy_find(VerseIndexReader const & index, std::string const & phrase,
+                                        int max_distance, unsigned jobs) {
+    MyersMatcher matcher(phrase);
+    std::vector<std::size_t> chapter_starts;
+    for (std::size_t doc = 0; doc < index.size(); ++doc) {
+        if (doc == 0 || (index.id(doc) >> 16) != (index.id(doc - 1) >> 16)) chapter_starts.push_back(doc);
+    }
+    chapter_starts.push_back(index.size());
+
+    std::vector<std::vector<FuzzyHit>> chapter_hits(chapter_starts.size() - 1);
+    {
+        WorkPool pool(jobs);
+        for (std::size_t c = 0; c + 1 < chapter_starts.size(); ++c) {
+            pool.submit([&, c] {
+                for (std::size_t doc = chapter_starts[c]; doc < chapter_starts[c + 1]; ++doc) {
+                    char const * text = index.folded_data(doc);
+                    std::size_t end;
+                    int distance = matcher.best(text, text + index.folded_size(doc), end);
+                    if (distance <= max_distance) chapter_hits[c].push_back(FuzzyHit{distance, doc, end});
+                }
+            });
+        }
+        pool.wait();
+    }
+
+    std::vector<FuzzyHit> hits;
+    for (auto & h: chapter_hits) hits.insert(hits.end(), h.begin(), h.end());
+    std::stable_sort(hits.begin(), hits.end());
+    return hits;
+}
+
+// the line of a verse that holds folded offset end - 1
+static std::string line_at(VerseIndexReader const & index, std::size_t doc, std::size_t end) {
+    std::string text(index.text_data(doc), index.text_size(doc));
+    std::string folded;
+    std::size_t start = 0;
+    for (;;) {
+        std::size_t nl = text.find('\n', start);
+        std::size_t stop = nl == std::string::npos ? text.size() : nl;
+        fold_for_search(text.data() + start, text.data() + stop, folded);
+        if (folded.size() >= end || nl == std::string::npos) return text.substr(start, stop - start);
+        start = nl + 1;
+    }
+}
+
+int main(int argc, char * argv[]) {
+    bool count_only = false;
+    bool show_time = false;
+    int max_distance = -1;
+    std::size_t top = 10;
+    unsigned jobs = std::thread::hardware_concurrency();
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        if (std::string(argv[i]) == "--count") {
+            count_only = true;
+        } else if (std::string(argv[i]) == "--time") {
+            show_time = true;
+        } else if (std::string(argv[i]) == "--fuzzy" && i + 1 < argc) {
+            max_distance = std::atoi(argv[++i]);
+        } else if (std::string(argv[i]) == "--top" && i + 1 < argc) {
+            top = static_cast<std::size_t>(std::atol(argv[++i]));
+        } else if (std::string(argv[i]) == "--jobs" && i + 1 < argc) {
+            jobs = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else {
+            fprintf(stderr, "unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (argc - i < 2) {
+        fprintf(stderr, "usage: sb-search [--count] [--time] [--fuzzy D [--top K] [--jobs N]]"
+                        " INDEX WORDS...\n");
+        return 1;
+    }
+    char const * index_name = argv[i++];
+    std::string query = argv[i++];
+    for (; i < argc; ++i) {
+        query += ' ';
+        query += argv[i];
+    }
+
+    try {
+        VerseIndexReader index(index_name);
+        auto start = std::chrono::steady_clock::now();
+        std::size_t matches;
+        std::chrono::steady_clock::duration elapsed;
+        if (max_distance >= 0) {
+            std::string phrase;
+            fold_for_search(query.data(), query.data() + query.size(), phrase);
+            if (phrase.empty() || phrase.size() > MyersMatcher::max_pattern) {
+                fprintf(stderr, "fuzzy search needs 1 to %zu letters, not %zu\n",
+                        MyersMatcher::max_pattern, phrase.size());
+                return 1;
+            }
+            auto hits = fuzzy_find(index, phrase, max_distance, jobs);
+            elapsed = std::chrono::steady_clock::now() - start;
+            matches = hits.size();
+            if (!count_only) {
+                for (std::size_t h = 0; h < hits.size() && h < top; ++h) {
+                    printf("%s (%d): %s\n", verse_id_to_string(index.id(hits[h].doc)).c_str(),
+                           hits[h].distance, line_at(index, hits[h].doc, hits[h].end).c_str());
+                }
+            }
+        } else {
+            auto found = index.find(query);
+            elapsed = std::chrono::steady_clock::now() - start;
+            matches = found.size();
+            if (!count_only) {
+                for (auto doc: found) {
+                    std::string text(index.text_data(doc), index.text_size(doc));
+                    for (std::size_t nl = text.find('\n'); nl != std::string::npos; nl = text.find('\n', nl)) {
+                        text.replace(nl, 1, " / ");
+                    }
+                    printf("%s: %s\n", verse_id_to_string(index.id(doc)).c_str(), text.c_str());
+                }
+            }
+        }
+        if (count_only) printf("%zu\n", matches);
+        if (show_time) {
+            fprintf(stderr, "%zu matches in %.3f ms\n", matches,
+                    std::chrono::duration<double, std::milli>(elapsed).count());
+        }
+    } catch (std::exception const & e) {
+        fprintf(stderr, "%s: %s\n", index_name, e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -1,306 +1,138 @@
-#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 #include <iostream>
-#include <map>
-#include <regex>
-#include <stdexcept>
-#include "rtfparser.h"
-
-class VerseRange {
-public:
-    VerseRange() = default;
-    void start_text_range(std::string const & text_first, std::string const & text_last="") {
-        text_first_ = text_first;
-        text_last_ = !text_last.empty() ? text_last : text_first;
-        check_numbers();
-    }
-
-    void start_chapter(std::string const & new_canto, std::string const & new_chapter) {
-        canto_ = new_canto;
-        chapter_ = new_chapter;
-    }
-
-    void clear() {
-        text_first_ = ""; text_last_ = "";
-    }
-    bool empty() {
-        return text_first_.empty();
-    }
-    void error(char const * msg) {
-        std::cerr << msg << ": " << canto_ << '.' << chapter_ << '.' << text_first_ << '-' << text_last_
-            << " (previous: " << prev_canto << '.' << prev_chapter << '.' << prev_text << ")\n";
-        std::exit(1);
-    }
-
-    int verse_num(std::string const & s) {
-        return atoi(s.c_str());
-    }
-
-    void check_numbers() {
-        if (canto_ != prev_canto) {
-            if (verse_num(canto_) != verse_num(prev_canto)+1) {
-                error("unexpected canto");
-            }
-            if (chapter_ != "1") {
-                error("unexpected chapter");
-            }
-            if (text_first_ != "1") {
-                error("unexpected text number(1)");
-            }
-        } else if (chapter_ != prev_chapter) {
-            if (verse_num(chapter_) != verse_num(prev_chapter)+1) {
-                error("unexpected chapter");
-            }
-            if (text_first_ != "1") {
-                error("unexpected text number(2)");
-            }
-        } else if (verse_num(text_first_) != verse_num(prev_text)+1) {
-            if (canto_ == "4" && chapter_ == "29" && text_first_ == "1a" && prev_text == "85") {
-                // it's OK, no error, just weird numbering in 4.29.85 => 4.29.1a-2a
-            } else if (canto_ == "4" && chapter_ == "29" && text_first_ == "1b" && prev_text == "2a") {
-                // it's OK, no error, just weird numbering in 4.29.1a-2a => 4.29.1b
-            } else {
-                error("unexpected text number(3)");
-            }
+#include <string>
+#include <vector>
+#include "input.h"
+#include "repeats.h"
+#include "sb-sloka-counter.h"
+#include "stats.h"
+#include "verse-columns.h"
+#include "verse-index.h"
+#include "word-stats.h"
+
+int main(int argc, char * argv[]) {
+    bool show_meters = false;
+    bool totals_only = false;
+    char const * binary_name = nullptr;
+    char const * index_name = nullptr;
+    long word_stats_top = -1;
+    bool repeats = false;
+    bool unique_totals = false;
+    bool validate_only = false;
+    ReportFormat format = ReportFormat::text;
+    bool stats = false;
+    char const * stats_json_name = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--meters") {
+            show_meters = true;
+        } else if (std::string(argv[i]) == "--totals-only") {
+            totals_only = true;
+        } else if (std::string(argv[i]) == "--emit-binary" && i + 1 < argc) {
+            binary_name = argv[++i];
+        } else if (std::string(argv[i]) == "--index" && i + 1 < argc) {
+            index_name = argv[++i];
+        } else if (std::string(argv[i]) == "--word-stats" && i + 1 < argc) {
+            word_stats_top = std::atol(argv[++i]);
+        } else if (std::string(argv[i]) == "--repeats") {
+            repeats = true;
+        } else if (std::string(argv[i]) == "--unique-totals") {
+            unique_totals = true;
+        } else if (std::string(argv[i]) == "--validate-only") {
+            validate_only = true;
+        } else if (std::string(argv[i]) == "--format" && i + 1 < argc
+                   && parse_format(argv[i + 1], format)) {
+            ++i;
+        } else if (std::string(argv[i]) == "--stats") {
+            stats = true;
+        } else if (std::string(argv[i]) == "--stats-json" && i + 1 < argc) {
+            stats_json_name = argv[++i];
+        } else {
+            fprintf(stderr, "unknown option: %s\n", argv[i]);
+            return 1;
         }
-        if (verse_num(text_last_) < verse_num(text_first_)) {
-            error("unexpected text range");
-        }
-        prev_canto = canto_;
-        prev_chapter = chapter_;
-        prev_text = text_last_;
-    }
-
-    std::string canto() {
-        return canto_;
-    }
-
-    std::string chapter() {
-        return chapter_;
     }
 
-private:
-    std::string canto_, chapter_, text_first_, text_last_;
-    std::string prev_canto = "";
-    std::string prev_chapter = "";
-    std::string prev_text = "";
-
-    friend std::ostream & operator << (std::ostream & stream, VerseRange & r);
-};
-
-std::ostream & operator << (std::ostream & stream, VerseRange & r) {
-    stream << r.canto_ << '.' << r.chapter_ << '.' << r.text_first_;
-    if (r.text_last_ != r.text_first_) {
-        stream << '-' << r.text_last_;
-    }
-    return stream;
-}
-
-int total_syllables=0;
-int total_syllables_no_uvaca=0;
-std::map<std::string, int> total_by_chapter;
-
-class SbSlokaCounter {
-public:
-    void write(std::string const & string, CHP const & chp) {
-        if (int(chp.cur_font) != 0) return;
-        cur_line += string;
-        std::string::size_type pos;
-        while ((pos=cur_line.find('\n')) != std::string::npos) {
-            parse_line(cur_line.substr(0, pos+1), chp);
-            cur_line = cur_line.substr(pos+1);
-        }
-    }
-
-private:
-    VerseRange verse_range;
-    std::string cur_line;
-
-    bool check_for_verse_start(std::string const & line) {
-        static std::regex r(R"re(^TEXTS? (\d+[ab]?)(?:[-\x96]{1,2}(\d+[ab]?))?\n*$)re");
-        std::smatch match;
-        if (std::regex_search(line, match, r)) {
-            verse_range.start_text_range(match.str(1), match.str(2));
-            return true;
-        }
-        return false;
-    }
-
-    void show_matches(std::smatch const & m) {
-        for (std::size_t n=0; n < m.size(); ++n) {
-            std::cout << " m[" << n << "]='" << m.str(n) << "'\n";
-        }
-        std::cout << "suffix='" << m.suffix().str() << "'\n";
-    }
-
-    bool check_for_chapter_start(std::string const & line) {
-        static std::regex r(R"re(^SB (\d+).(\d+):)re");
-        std::smatch match;
-
-        if (std::regex_search(line, match, r)) {
-            //show_matches(match);
-            verse_range.start_chapter(match.str(1), match.str(2));
-            return true;
-        }
-        //std::cout << "no match: " << line;
-        return false;
+    std::string error;
+    auto in = open_input_or_compressed("sb.rtf", error);
+    if (!in) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
     }
 
-    bool check_verse_end(std::string const & line) {
-        return (line == "SYNONYMS\n");
+    if (stats || stats_json_name) {
+        run_stats.start();
     }
 
-    std::string balaram_font_to_unicode(std::string const & s) {
-        std::string u;
-        for (auto c: s) {
-            switch (static_cast<unsigned char>(c)) {
-                case 0x92: u += "'"; break;
-                case 0x97: u += "—"; break;
-                case 0xe0: u += "ṁ"; break;
-                case 0xe4: u += "ā"; break;
-                case 0xe5: u += "ṛ"; break;
-                case 0xe7: u += "ś"; break;
-                case 0xe8: u += "ṝ"; break;
-                case 0xe9: u += "ī"; break;
-                case 0xeb: u += "ṇ"; break;
-                case 0xec: u += "ṅ"; break;
-                case 0xef: u += "ñ"; break;
-                case 0xf1: u += "ṣ"; break;
-                case 0xf2: u += "ḍ"; break;
-                case 0xf6: u += "ṭ"; break;
-                case 0xf9: u += "ḥ"; break;
-                case 0xfb: u += "ḻ"; break;
-                case 0xfc: u += "ū"; break;
-                case 0xff: u += "ḷ"; break;
-                default: u += c;
-            }
+    if (validate_only) {
+        // the markers can be split by RTF groups and escapes, so this still
+        // goes through the tokenizer, but stops at classifying the lines
+        RtfParser<SbSlokaCounter> p;
+        p.GetOutputter().set_validate_only(true);
+        Status ec = p.RtfParse(*in);
+        if (ec == Status::ReadError) {
+            fprintf(stderr, "sb.rtf: %s\n", in->error().c_str());
+            return 1;
         }
-        return u;
+        if (ec != Status::OK) fprintf(stderr, "error %d parsing RTF\n", int(ec));
+        bool valid = print_problems(p.GetOutputter().problems()) && ec == Status::OK;
+        return report_stats(stats, stats_json_name) && valid ? 0 : 1;
     }
 
-    bool ends_with(std::string const & subject, std::string const & with) {
-        auto subject_size = subject.size();
-        auto with_size = with.size();
-        if (subject_size < with_size) return false;
-        auto start = subject_size - with_size;
-        return (subject.compare(start, with_size, with) == 0);
-    }
-
-    // true if this is "... uvaaca" line
-    bool uvaca(std::string const & line) {
-        static std::vector<std::string> uvacas = {
-            "ov\xe4" "ca", // for rajovaaca, brahmovaaca, etc.
-            " uv\xe4" "ca", // for generic singular "xxx uvaaca"
-            " \xfc" "cu\xf9", // for generic plural "xxx uucuH"
-        };
-        return std::any_of(uvacas.begin(), uvacas.end(),
-            [&](std::string const & u) { return ends_with(line, u); });
-        //return ends_with(s, uvacas[0]) || ends_with(s, uvacas[1]);
+    RtfParser<SbSlokaCounter> p;
+    p.GetOutputter().set_show_meters(show_meters);
+    p.GetOutputter().set_print_lines(!totals_only);
+    p.GetOutputter().set_format(format);
+    VerseColumnsWriter columns;
+    VerseIndexWriter index;
+    WordStats word_stats;
+    RepeatFinder repeat_finder;
+    if (binary_name || index_name || word_stats_top >= 0 || repeats || unique_totals) {
+        p.GetOutputter().set_line_sink(
+            [&](std::uint32_t id, int syllables, bool uvaca, std::string const & text) {
+                if (binary_name) columns.add(id, syllables, uvaca, text);
+                if (index_name) index.add(id, text);
+                if (word_stats_top >= 0) word_stats.add_line(id, text);
+                if (repeats || unique_totals) repeat_finder.add_line(id, syllables, uvaca, text);
+            });
+    }
+    Status ec;
+    try {
+        ec = p.RtfParse(*in);
+    } catch (std::exception const & e) {
+        p.GetOutputter().flush();
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
     }
-
-    int syllables(std::string const & s) {
-        int syllables_count = 0;
-        auto size = s.size();
-        for (unsigned i=0; i<size; ++i) {
-            switch (static_cast<unsigned char>(s[i])) {
-                // a is handled below because of ai and au
-                case 0xe4: // aa
-                case 'i':  // i
-                case 0xe9: // ii
-                case 'u':  // u
-                case 0xfc: // uu
-                case 0xe5: // R
-                case 0xe8: // RR
-                case 0xff: // L
-                // missing in source encoding: LL
-                case 'e':  // e
-                case 'o':  // o
-                    ++syllables_count;
-                    break;
-                case 'a':  // a
-                    if (i+1 < size && (s[i+1] == 'i' || s[i+1] == 'u')) {
-                        ++i;
-                    }
-                    ++syllables_count;
-                    break;
-                default:
-                    break;
-            }
-        }
-        return syllables_count;
+    if (ec == Status::ReadError) {
+        p.GetOutputter().flush();
+        fprintf(stderr, "sb.rtf: %s\n", in->error().c_str());
+        return 1;
     }
-
-    void parse_verse_line(std::string const & line) {
-        if (check_verse_end(line)) {
-            verse_range.clear();
-            std::cout << std::flush;
-            return;
-        }
-
-        if (line == "TEXT\n") return;
-
-        std::string our_line = line;
-        // trim tailing newline for unification
-        auto size = our_line.size();
-        if (size >= 1 && our_line[size-1] == '\n') {
-            our_line.resize(size-1);
-        }
-
-        // skip all-whitespace lines
-        if (std::all_of(our_line.begin(), our_line.end(), [](char c){ return std::isspace(c);})) {
-            return;
-        }
-
-        auto syllables_count = syllables(our_line);
-        total_syllables += syllables_count;
-
-        std::string canto_padded = (verse_range.canto().size() < 2 ? "0" : "") + verse_range.canto();
-        std::string chapter_padded = (verse_range.chapter().size() < 2 ? "0" : "") + verse_range.chapter();
-        std::string canto_chapter = canto_padded + "." + chapter_padded;
-        std::string canto_dot_x = canto_padded + ".x";
-        total_by_chapter[canto_chapter] += syllables_count;
-        total_by_chapter[canto_dot_x] += syllables_count;
-
-        bool is_uvaca = uvaca(our_line);
-        if (!is_uvaca) {
-            total_syllables_no_uvaca += syllables_count;
-        }
-
-        std::cout
-            << verse_range << '(' << syllables_count << (is_uvaca ? "'" : "")
-            << "): " << balaram_font_to_unicode(our_line) << '\n';
+    if (ec != Status::OK) {
+        p.GetOutputter().flush();
+        fprintf(stderr, "error %d parsing RTF\n", int(ec));
     }
 
-    void parse_line(std::string const & line, CHP const & /*chp*/) {
-        if (verse_range.empty()) {
-            if (check_for_verse_start(line)) return;
-            if (check_for_chapter_start(line)) return;
-            return;
-        }
-
-        parse_verse_line(line);
+    p.GetOutputter().print_totals();
+    if (word_stats_top >= 0) {
+        word_stats.write(stdout, static_cast<std::size_t>(word_stats_top));
     }
+    if (unique_totals) repeat_finder.write_unique_totals(stdout);
+    if (repeats) repeat_finder.write(stdout);
 
-};
-
-int main() {
-    FILE *f = fopen("sb.rtf", "r");
-    if (!f) {
-        fprintf(stderr, "Can't open sb.rtf");
+    if (binary_name && !columns.write(binary_name)) {
+        fprintf(stderr, "can't write %s\n", binary_name);
         return 1;
     }
-
-    RtfParser<SbSlokaCounter> p;
-    Status ec = p.RtfParse(f);
-    if (ec != Status::OK) {
-        fprintf(stderr, "error %d parsing RTF\n", int(ec));
+    if (index_name && !index.write(index_name)) {
+        fprintf(stderr, "can't write %s\n", index_name);
+        return 1;
     }
-
-    for (auto & pair: total_by_chapter) {
-        std::cout << "chapter " << pair.first << ": " << pair.second << '\n';
+    if (p.GetOutputter().output_failed()) {
+        fprintf(stderr, "can't write the report\n");
+        return 1;
     }
 
-    std::cout << "total syllables: " << total_syllables << '\n';
-    std::cout << "total syllables (no uvaaca): " << total_syllables_no_uvaca << '\n';
-    fclose(f);
+    return report_stats(stats, stats_json_name) ? 0 : 1;
 }
@@ -0,0 +1,211 @@
+#ifndef sb_sloka_counter_h
+#define sb_sloka_counter_h
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <vector>
+#include "rtfparser.h"
+#include "encodings.h"
+#include "probes.h"
+#include "sloka-counter-base.h"
+#include "stats.h"
+#include "verse.h"
+
+class SbSlokaCounter : public SlokaCounterBase {
+public:
+    SbSlokaCounter() {
+        cur_line.reserve(64 * line_capacity);   // and text runs
+        line_buf.reserve(line_capacity);
+    }
+
+    // Only check the headings and the numbering, collecting every problem
+    // in problems() instead of stopping at the first; no syllables are
+    // counted and nothing is printed.
+    void set_validate_only(bool validate) {
+        validate_only = validate;
+        verse_range.collect_problems(validate);
+    }
+
+    std::vector<std::string> const & problems() const {
+        return verse_range.problems();
+    }
+
+    void write(std::string const & string, CHP const & chp) {
+        if (int(chp.cur_font) != 0) return;
+        cur_line += string;
+        std::string::size_type start = 0, pos;
+        while ((pos=cur_line.find('\n', start)) != std::string::npos) {
+            line_buf.assign(cur_line, start, pos+1 - start);
+            parse_line(line_buf, chp);
+            start = pos+1;
+        }
+        cur_line.erase(0, start);
+    }
+
+private:
+    VerseRange verse_range;
+    std::string cur_line;
+    std::string line_buf;           // per-line buffer, kept to reuse its capacity
+    std::string match1, match2;
+    bool validate_only = false;
+    bool in_chapter = false;
+    long line_count = 0;
+    long text_offset = 0;
+
+    // digits and an optional a/b at p; returns the end, or p if there are no digits
+    static char const * scan_text_number(char const * p, char const * end) {
+        char const * q = p;
+        while (q < end && *q >= '0' && *q <= '9') ++q;
+        if (q == p) return p;
+        if (q < end && (*q == 'a' || *q == 'b')) ++q;
+        return q;
+    }
+
+    // ^TEXTS? (\d+[ab]?)(?:[-\x96]{1,2}(\d+[ab]?))?\n*$
+    bool check_for_verse_start(std::string const & line) {
+        if (!match_verse_start(line)) return false;
+        verse_range.start_text_range(match1, match2);
+        SB_PROBE1(verse_start, verse_range.id());
+        if (!in_chapter) enter_chapter();       // verses before any "SB c.c:" heading
+        return true;
+    }
+
+    // the text numbers into match1 and match2
+    bool match_verse_start(std::string const & line) {
+        char const * p = line.data();
+        char const * end = p + line.size();
+        if (line.compare(0, 4, "TEXT") != 0) return false;
+        p += 4;
+        if (p < end && *p == 'S') ++p;
+        if (p == end || *p++ != ' ') return false;
+        char const * first = p;
+        char const * first_end = scan_text_number(p, end);
+        if (first_end == first) return false;
+        p = first_end;
+        char const * last = p;
+        char const * last_end = p;
+        int dashes = 0;
+        while (dashes < 2 && p < end && (*p == '-' || *p == '\x96')) {
+            ++p;
+            ++dashes;
+        }
+        if (dashes > 0) {
+            last = p;
+            last_end = scan_text_number(p, end);
+            if (last_end == last) return false;
+            p = last_end;
+        }
+        while (p < end && *p == '\n') ++p;
+        if (p != end) return false;
+        match1.assign(first, first_end);
+        match2.assign(last, last_end);
+        return true;
+    }
+
+    // ^SB (\d+).(\d+):
+    bool check_for_chapter_start(std::string const & line) {
+        if (!match_chapter_start(line)) return false;
+        verse_range.start_chapter(match1, match2);
+        SB_PROBE2(chapter, verse_range.verse_num(match1), verse_range.verse_num(match2));
+        enter_chapter();
+        return true;
+    }
+
+    // the canto and chapter into match1 and match2
+    bool match_chapter_start(std::string const & line) {
+        char const * p = line.data();
+        char const * end = p + line.size();
+        if (line.compare(0, 3, "SB ") != 0) return false;
+        p += 3;
+        char const * canto = p;
+        while (p < end && *p >= '0' && *p <= '9') ++p;
+        // backtrack like the regex would: the separator may be a digit too
+        for (char const * canto_end = p; canto_end > canto; --canto_end) {
+            if (canto_end == end || *canto_end == '\n' || *canto_end == '\r') continue;
+            char const * chapter = canto_end + 1;
+            char const * q = chapter;
+            while (q < end && *q >= '0' && *q <= '9') ++q;
+            if (q == chapter || q == end || *q != ':') continue;
+            match1.assign(canto, canto_end);
+            match2.assign(chapter, q);
+            return true;
+        }
+        return false;
+    }
+
+    void enter_chapter() {
+        SlokaCounterBase::enter_chapter(verse_range.canto(), verse_range.chapter());
+        in_chapter = true;
+    }
+
+    bool check_verse_end(std::string const & line) {
+        return (line == "SYNONYMS\n");
+    }
+
+    // syllables in the line, 0 if it isn't a verse line
+    int parse_verse_line(std::string & line) {
+        if (check_verse_end(line)) {
+            verse_totals.id = verse_range.id();
+            verse_totals.last_text = verse_range.last_text();
+            end_verse();
+            verse_range.clear();
+            return 0;
+        }
+
+        if (line == "TEXT\n") return 0;
+
+        std::string & our_line = line;
+        // trim tailing newline for unification
+        auto size = our_line.size();
+        if (size >= 1 && our_line[size-1] == '\n') {
+            our_line.resize(size-1);
+        }
+
+        // skip all-whitespace lines
+        if (std::all_of(our_line.begin(), our_line.end(), [](char c){ return std::isspace(c);})) {
+            return 0;
+        }
+
+        return count_verse_line<BalaramEncoding>(our_line, is_uvaca<BalaramEncoding>(our_line),
+                                                 verse_range.id(), verse_range.last_id());
+    }
+
+    // Inside a verse only its end matters; a heading there means the
+    // SYNONYMS line is missing, and would be counted as verse text.
+    void validate_verse_line(std::string const & line) {
+        if (check_verse_end(line)) {
+            verse_range.clear();
+        } else if (match_verse_start(line) || match_chapter_start(line)) {
+            verse_range.error("no SYNONYMS after the verse");
+            verse_range.clear();
+            if (!check_for_verse_start(line)) check_for_chapter_start(line);
+        }
+    }
+
+    void parse_line(std::string & line, CHP const & /*chp*/) {
+        stats_count(StatCounter::lines);
+        StatsStage stage(Stage::classify);
+        ++line_count;
+        SB_PROBE2(line_start, line_count, text_offset);
+        text_offset += static_cast<long>(line.size());
+        if (verse_range.empty()) {
+            if (!check_for_verse_start(line)) check_for_chapter_start(line);
+            SB_PROBE2(line_end, 0, 0);
+            return;
+        }
+
+        if (validate_only) {
+            validate_verse_line(line);
+            SB_PROBE2(line_end, 0, 0);
+            return;
+        }
+
+        std::uint32_t id = verse_range.id();
+        int syllables_count = parse_verse_line(line);
+        SB_PROBE2(line_end, id, syllables_count);
+    }
+
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include "sbcount.h"
+
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <istream>
+#include <new>
+#include <string>
+
+#include "input.h"
+#include "sb-itx-sloka-counter.h"
+#include "sb-sloka-counter.h"
+
+struct sb_context {
+    sb_input_format format;
+    std::string error;
+    CountTotals totals;
+};
+
+// writes verse records into the caller's array while there is room,
+// counting all of them
+class VerseArray {
+public:
+    VerseArray(sb_verse * verses, std::size_t capacity) : verses_(verses), capacity_(capacity) {}
+
+    void operator()(VerseRecord const & r) {
+        if (count < capacity_) {
+            verses_[count] = sb_verse{r.id, r.last_text, r.syllables, r.syllables_no_uvaca};
+        }
+        ++count;
+    }
+
+    std::size_t count = 0;
+
+private:
+    sb_verse * verses_;
+    std::size_t capacity_;
+};
+
+static sb_status fail(sb_context * ctx, sb_status status, std::string const & message) {
+    ctx->error = message;
+    return status;
+}
+
+// verse records only, no report
+template <class Counter>
+static void collect(Counter & c, VerseArray & out) {
+    c.set_print_lines(false);
+    c.set_verse_sink(std::ref(out));
+}
+
+static sb_status count(sb_context * ctx, ByteSource & in, sb_verse * verses, std::size_t capacity,
+                       std::size_t * verse_count, sb_totals * totals) {
+    ctx->totals = CountTotals();
+    VerseArray out(verses, capacity);
+    try {
+        if (ctx->format == SB_INPUT_RTF) {
+            RtfParser<SbSlokaCounter> p;
+            collect(p.GetOutputter(), out);
+            Status ec = p.RtfParse(in);
+            if (ec == Status::ReadError) return fail(ctx, SB_ERROR_READ, in.error());
+            if (ec != Status::OK) {
+                return fail(ctx, SB_ERROR_PARSE, "error " + std::to_string(int(ec)) + " parsing RTF");
+            }
+            p.GetOutputter().add_totals_to(ctx->totals);
+        } else {
+            SourceStreambuf buf(in);
+            std::istream f(&buf);
+            SlokaCounter c;
+            if (ctx->format == SB_INPUT_UTF8) c.set_encoding(TextEncoding::utf8);
+            collect(c, out);
+            c.count(f);
+            if (!in.error().empty()) return fail(ctx, SB_ERROR_READ, in.error());
+            c.add_totals_to(ctx->totals);
+        }
+    } catch (std::bad_alloc const &) {
+        ctx->totals = CountTotals();
+        return fail(ctx, SB_ERROR_MEMORY, "out of memory");
+    } catch (std::exception const & e) {
+        ctx->totals = CountTotals();
+        return fail(ctx, SB_ERROR_INPUT, e.what());
+    }
+    if (verse_count) *verse_count = out.count;
+    if (totals) {
+        totals->syllables = ctx->totals.syllables;
+        totals->syllables_no_uvaca = ctx->totals.syllables_no_uvaca;
+        totals->verses = out.count;
+    }
+    if (out.count > capacity) {
+        return fail(ctx, SB_ERROR_TRUNCATED, "more verses than capacity");
+    }
+    return SB_OK;
+}
+
+sb_context * sb_context_new(sb_input_format format) {
+    sb_context * ctx = new (std::nothrow) sb_context;
+    if (ctx) ctx->format = format;
+    return ctx;
+}
+
+void sb_context_free(sb_context * ctx) {
+    delete ctx;
+}
+
+sb_status sb_count_buffer(sb_context * ctx, char const * data, size_t size,
+                          sb_verse * verses, size_t capacity, size_t * verse_count,
+                          sb_totals * totals) {
+    if (!ctx) return SB_ERROR_ARGUMENT;
+    ctx->error.clear();
+    if ((!data && size > 0) || (!verses && capacity > 0)) {
+        return fail(ctx, SB_ERROR_ARGUMENT, "null buffer");
+    }
+    MemorySource in(data, size);
+    return count(ctx, in, verses, capacity, verse_count, totals);
+}
+
+sb_status sb_count_file(sb_context * ctx, char const * path,
+                        sb_verse * verses, size_t capacity, size_t * verse_count,
+                        sb_totals * totals) {
+    if (!ctx) return SB_ERROR_ARGUMENT;
+    ctx->error.clear();
+    if (!path || (!verses && capacity > 0)) {
+        return fail(ctx, SB_ERROR_ARGUMENT, "null path or buffer");
+    }
+    try {
+        std::string error;
+        auto in = open_input(path, error);
+        if (!in) return fail(ctx, SB_ERROR_READ, error);
+        return count(ctx, *in, verses, capacity, verse_count, totals);
+    } catch (std::bad_alloc const &) {
+        ctx->totals = CountTotals();
+        return fail(ctx, SB_ERROR_MEMORY, "out of memory");
+    } catch (std::exception const & e) {
+        // e.g. the decompression thread couldn't start
+        ctx->totals = CountTotals();
+        return fail(ctx, SB_ERROR_INPUT, e.what());
+    }
+}
+
+sb_status sb_chapters(sb_context const * ctx, sb_chapter * chapters, size_t capacity,
+                      size_t * chapter_count) {
+    if (!ctx || (!chapters && capacity > 0)) return SB_ERROR_ARGUMENT;
+    std::size_t n = 0;
+    for (auto & pair: ctx->totals.by_chapter) {
+        // "01.02", or "01.x" for the canto
+        if (n < capacity) {
+            std::string const & key = pair.first;
+            chapters[n] = sb_chapter{std::atoi(key.c_str()), std::atoi(key.c_str() + 3), pair.second};
+        }
+        ++n;
+    }
+    if (chapter_count) *chapter_count = n;
+    return n > capacity ? SB_ERROR_TRUNCATED : SB_OK;
+}
+
+char const * sb_last_error(sb_context const * ctx) {
+    return ctx ? ctx->error.c_str() : "null context";
+}
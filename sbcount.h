@@ -0,0 +1,105 @@
+#ifndef sbcount_h
+#define sbcount_h
+
+// C interface to the counters, for embedding them in other programs
+// (Python ctypes/cffi, cgo...) instead of running the executables.
+//
+// A context counts one document per call and keeps only its last results
+// between calls. Contexts share nothing, so threads can count in parallel
+// with a context each; a single context must not be used by two threads at
+// once. Input is read in place from the caller's buffer, and verse results
+// are written straight into the caller's array.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  if defined(SBCOUNT_BUILD_SHARED)
+#    define SB_API __declspec(dllexport)
+#  elif defined(SBCOUNT_SHARED)
+#    define SB_API __declspec(dllimport)
+#  else
+#    define SB_API
+#  endif
+#elif defined(__GNUC__)
+#  define SB_API __attribute__((visibility("default")))
+#else
+#  define SB_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum sb_input_format {
+    SB_INPUT_ITX = 0,           // bhagpur.itx style ITRANS text
+    SB_INPUT_RTF = 1,           // sb.rtf style RTF in the Balaram font
+    SB_INPUT_UTF8 = 2           // bhagpur.itx style lines with UTF-8 IAST or Devanagari text
+} sb_input_format;
+
+typedef enum sb_status {
+    SB_OK = 0,
+    SB_ERROR_ARGUMENT = 1,      // null context, or null array with nonzero capacity
+    SB_ERROR_READ = 2,          // can't open, read or decompress the input
+    SB_ERROR_PARSE = 3,         // malformed RTF
+    SB_ERROR_INPUT = 4,         // text the counter can't make sense of, e.g. verse numbering
+    SB_ERROR_TRUNCATED = 5,     // more records than capacity; the count says how many
+    SB_ERROR_MEMORY = 6
+} sb_status;
+
+// One verse. A "TEXTS 1-2" range in the RTF is a single record with
+// last_text 2.
+typedef struct sb_verse {
+    uint32_t id;                // canto << 24 | chapter << 16 | text << 4 | part (a=1, b=2)
+    int32_t last_text;
+    int32_t syllables;
+    int32_t syllables_no_uvaca;
+} sb_verse;
+
+// Syllables in a chapter, or in a whole canto when chapter is 0.
+typedef struct sb_chapter {
+    int32_t canto;
+    int32_t chapter;
+    int32_t syllables;
+} sb_chapter;
+
+typedef struct sb_totals {
+    int64_t syllables;
+    int64_t syllables_no_uvaca;
+    uint64_t verses;
+} sb_totals;
+
+typedef struct sb_context sb_context;
+
+// Null if out of memory.
+SB_API sb_context * sb_context_new(sb_input_format format);
+SB_API void sb_context_free(sb_context * ctx);
+
+// Counts the uncompressed document in data[0, size). The first capacity
+// verses go to verses (which may be null when capacity is 0) and
+// *verse_count is set to the number found, so a caller can size the array
+// and count again after SB_ERROR_TRUNCATED. verse_count and totals may be
+// null.
+SB_API sb_status sb_count_buffer(sb_context * ctx, char const * data, size_t size,
+                                 sb_verse * verses, size_t capacity, size_t * verse_count,
+                                 sb_totals * totals);
+
+// The same for a file, plain or gzip/zstd-compressed.
+SB_API sb_status sb_count_file(sb_context * ctx, char const * path,
+                               sb_verse * verses, size_t capacity, size_t * verse_count,
+                               sb_totals * totals);
+
+// Chapter and canto totals of the last successful count, in the order of
+// the text report (a canto's total after its chapters).
+SB_API sb_status sb_chapters(sb_context const * ctx, sb_chapter * chapters, size_t capacity,
+                             size_t * chapter_count);
+
+// Why the last call on ctx failed; "" after a success. Valid until the
+// next call on ctx.
+SB_API char const * sb_last_error(sb_context const * ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef sloka_counter_base_h
+#define sloka_counter_base_h
+
+// What the two counters share once a line is known to be verse text: the
+// syllable count in the line's encoding, the verse, chapter and overall
+// totals, meters, the sinks and the report. SbSlokaCounter (sb.rtf) and
+// SlokaCounter (bhagpur.itx) only find the verse lines and their numbers
+// and pass each line to count_verse_line with its encoding.
+
+#include <cstdio>
+#include <functional>
+#include <string>
+
+#include "arena.h"
+#include "encodings.h"
+#include "meter.h"
+#include "report-writer.h"
+#include "stats.h"
+#include "verse.h"
+
+class SlokaCounterBase {
+public:
+    // Room for any real line up front, so that once the chapter and verse
+    // are set up counting a line doesn't touch the heap.
+    static const std::size_t line_capacity = 1024;
+
+    SlokaCounterBase() {
+        unicode.reserve(3 * line_capacity);
+    }
+
+    // also classify light/heavy syllables and report meters
+    void set_show_meters(bool show) {
+        show_meters = show;
+    }
+
+    // per-line output; off when only totals or verse records are needed
+    void set_print_lines(bool print) {
+        print_lines = print;
+    }
+
+    // called with the totals of every verse when it ends
+    void set_verse_sink(std::function<void(VerseRecord const &)> sink) {
+        verse_sink = std::move(sink);
+    }
+
+    // called for every verse line with its verse id and transliterated text
+    void set_line_sink(std::function<void(std::uint32_t, int, bool, std::string const &)> sink) {
+        line_sink = std::move(sink);
+    }
+
+    void set_format(ReportFormat format) {
+        writer.set_format(format);
+    }
+
+    // report goes to stdout unless redirected here
+    void set_output_fd(int fd) {
+        writer.set_fd(fd);
+    }
+
+    void print_totals() {
+        StatsStage stage(Stage::output);
+        for (auto & pair: total_by_chapter) {
+            writer.chapter(pair.first, pair.second);
+            if (show_meters) {
+                for (auto & meter: meters_by_chapter.find(pair.first)->second) {
+                    writer.chapter_meter(pair.first, meter.first, meter.second);
+                }
+            }
+        }
+
+        writer.totals(total_syllables, total_syllables_no_uvaca);
+        writer.flush();
+    }
+
+    void flush() {
+        writer.flush();
+    }
+
+    // true once part of the report couldn't be written
+    bool output_failed() const {
+        return writer.failed();
+    }
+
+    // adds this run's chapter and overall totals to t
+    void add_totals_to(CountTotals & t) const {
+        t.syllables += total_syllables;
+        t.syllables_no_uvaca += total_syllables_no_uvaca;
+        for (auto & pair: total_by_chapter) {
+            t.by_chapter[pair.first] += pair.second;
+        }
+        for (auto & pair: meters_by_chapter) {
+            auto & meters = t.meters_by_chapter[pair.first];
+            for (auto & meter: pair.second) meters[meter.first] += meter.second;
+        }
+    }
+
+protected:
+    VerseRecord verse_totals{};     // of the verse being read
+
+    // totals of a chapter, looked up once per chapter; canto and chapter
+    // are numbers as written, padded to "01.02"
+    void enter_chapter(std::string const & canto, std::string const & chapter) {
+        std::string canto_padded = (canto.size() < 2 ? "0" : "") + canto;
+        std::string chapter_padded = (chapter.size() < 2 ? "0" : "") + chapter;
+        std::string canto_chapter = canto_padded + "." + chapter_padded;
+        std::string canto_dot_x = canto_padded + ".x";
+        chapter_total = &total_by_chapter[canto_chapter];
+        canto_total = &total_by_chapter[canto_dot_x];
+        chapter_meters = &meter_counts(canto_chapter);
+        canto_meters = &meter_counts(canto_dot_x);
+    }
+
+    // A verse line in Encoding, without its newline: counted into the
+    // totals, passed to the sinks and reported as verse id (to last_id for
+    // a range). Returns its syllables.
+    template <class Encoding>
+    int count_verse_line(std::string const & text, bool uvaca, std::uint32_t id, std::uint32_t last_id) {
+        LinePattern pattern;
+        auto syllables_count = show_meters ? encoded_syllables<Encoding>(text, pattern)
+                                           : encoded_syllable_count<Encoding>(text);
+        total_syllables += syllables_count;
+
+        *chapter_total += syllables_count;
+        *canto_total += syllables_count;
+        char const * meter = nullptr;
+        if (show_meters) {
+            meter = identify_meter(pattern);
+            ++(*chapter_meters)[meter];
+            ++(*canto_meters)[meter];
+        }
+
+        if (!uvaca) {
+            total_syllables_no_uvaca += syllables_count;
+            verse_totals.syllables_no_uvaca += syllables_count;
+        }
+        verse_totals.syllables += syllables_count;
+        if (verse_sink) verse_totals.text_hash = add_to_verse_hash(verse_totals.text_hash, text);
+
+        if (!print_lines && !line_sink) return syllables_count;
+        to_unicode<Encoding>(text, unicode);
+        if (line_sink) {
+            line_sink(id, syllables_count, uvaca, unicode);
+        }
+
+        if (!print_lines) return syllables_count;
+        StatsStage stage(Stage::output);
+        writer.line(ReportLine{id, last_id, syllables_count, uvaca, &unicode, &pattern, meter});
+        return syllables_count;
+    }
+
+    // the verse totals to the verse sink, if the verse has lines
+    void end_verse() {
+        if (verse_totals.id != 0) {
+            stats_count(StatCounter::verses);
+            if (verse_sink) verse_sink(verse_totals);
+        }
+        verse_totals = VerseRecord{};
+    }
+
+private:
+    typedef ArenaMap<char const *, int, MeterNameLess> MeterCounts;
+
+    bool show_meters = false;
+    bool print_lines = true;
+    ReportWriter writer;
+    std::function<void(VerseRecord const &)> verse_sink;
+    std::function<void(std::uint32_t, int, bool, std::string const &)> line_sink;
+    std::string unicode;            // per-line buffer, kept to reuse its capacity
+
+    int total_syllables = 0;
+    int total_syllables_no_uvaca = 0;
+    // per-chapter results come from an arena released with the counter; its
+    // first block holds a whole corpus's (about 70KB, 160KB with meters), so
+    // it doesn't grow mid-run
+    Arena results_arena{256 * 1024};
+    ArenaMap<std::string, int> total_by_chapter{std::less<std::string>(),
+                                                ArenaAllocator<int>(results_arena)};
+    ArenaMap<std::string, MeterCounts> meters_by_chapter{std::less<std::string>(),
+                                                         ArenaAllocator<int>(results_arena)};
+    int * chapter_total = nullptr;
+    int * canto_total = nullptr;
+    MeterCounts * chapter_meters = nullptr;
+    MeterCounts * canto_meters = nullptr;
+
+    MeterCounts & meter_counts(std::string const & key) {
+        auto it = meters_by_chapter.find(key);
+        if (it == meters_by_chapter.end()) {
+            MeterCounts counts(MeterNameLess(), meters_by_chapter.get_allocator());
+            it = meters_by_chapter.emplace(key, std::move(counts)).first;
+        }
+        return it->second;
+    }
+};
+
+#endif
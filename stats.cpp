@@ -0,0 +1,202 @@
+#include "stats.h"
+
+#include <cstdlib>
+#include <new>
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/time.h>
+#endif
+
+RunStats run_stats;
+
+#ifndef SB_NO_STATS
+
+// Count heap allocations while stats are on.
+void * operator new(std::size_t size) {
+    if (run_stats.enabled.load(std::memory_order_relaxed)) run_stats.add(StatCounter::allocations, 1);
+    for (;;) {
+        if (void * p = std::malloc(size ? size : 1)) return p;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void * operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void * operator new(std::size_t size, std::nothrow_t const &) noexcept {
+    try {
+        return operator new(size);
+    } catch (std::bad_alloc const &) {
+        return nullptr;
+    }
+}
+
+void * operator new[](std::size_t size, std::nothrow_t const &) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void * p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void * p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void * p, std::nothrow_t const &) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void * p, std::nothrow_t const &) noexcept {
+    std::free(p);
+}
+
+#endif
+
+#ifndef _WIN32
+extern "C" void stats_sigprof(int) {
+    run_stats.cpu_sample();
+}
+#endif
+
+void RunStats::start() {
+    for (auto & n: counts) n = 0;
+    for (auto & n: wall_samples) n = 0;
+    for (auto & n: cpu_samples) n = 0;
+    arena_live = 0;
+    for (auto & stage: thread_stage) stage = -1;
+    threads = 0;
+    ++generation;
+    thread_slot()->store(static_cast<int>(Stage::other), std::memory_order_relaxed);
+    stopping = false;
+    enabled.store(true);
+    wall_start = std::chrono::steady_clock::now();
+    cpu_start = std::clock();
+#ifndef SB_NO_STATS
+    sampler = std::thread([this] {
+        while (!stopping.load(std::memory_order_relaxed)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            int n = threads.load(std::memory_order_relaxed);
+            if (n > max_threads) n = max_threads;
+            for (int i = 0; i < n; ++i) {
+                int s = thread_stage[i].load(std::memory_order_relaxed);
+                if (s >= 0) wall_samples[s].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    });
+#ifndef _WIN32
+    struct sigaction sa {};
+    sa.sa_handler = stats_sigprof;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPROF, &sa, nullptr);
+    struct itimerval timer {};
+    timer.it_interval.tv_usec = 1000;
+    timer.it_value.tv_usec = 1000;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+#endif
+#endif
+}
+
+void RunStats::stop() {
+    if (!enabled.load()) return;
+#ifndef SB_NO_STATS
+#ifndef _WIN32
+    struct itimerval timer {};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+#endif
+    stopping = true;
+    if (sampler.joinable()) sampler.join();
+#endif
+    wall_end = std::chrono::steady_clock::now();
+    cpu_end = std::clock();
+    enabled.store(false);
+}
+
+char const * RunStats::name(Stage s) {
+    static char const * const names[stages] = {
+        "other", "tokenize", "keyword", "group", "classify", "syllables", "transliterate", "output",
+    };
+    return names[static_cast<int>(s)];
+}
+
+char const * RunStats::name(StatCounter c) {
+    static char const * const names[counters] = {
+        "bytes", "keywords", "groups", "skipped_destinations", "lines", "verses", "allocations",
+        "arena_peak_bytes",
+    };
+    return names[static_cast<int>(c)];
+}
+
+double RunStats::wall_seconds() const {
+    return std::chrono::duration<double>(wall_end - wall_start).count();
+}
+
+double RunStats::cpu_seconds() const {
+    return static_cast<double>(cpu_end - cpu_start) / CLOCKS_PER_SEC;
+}
+
+// share of total time by sample count; no samples at all means the run was
+// too short to tell, and everything goes to "other"
+double RunStats::stage_seconds(std::atomic<std::uint64_t> const (&samples)[stages], int s,
+                               double total) const {
+    std::uint64_t sum = 0;
+    for (auto & n: samples) sum += n.load();
+    if (sum == 0) return s == 0 ? total : 0.0;
+    return total * static_cast<double>(samples[s].load()) / static_cast<double>(sum);
+}
+
+void RunStats::print(FILE * f) const {
+    double wall = wall_seconds();
+    double cpu = cpu_seconds();
+    fprintf(f, "%-14s %10s %10s\n", "stage", "wall ms", "cpu ms");
+    for (int s = 0; s < stages; ++s) {
+        fprintf(f, "%-14s %10.1f %10.1f\n", name(static_cast<Stage>(s)),
+                1000 * stage_seconds(wall_samples, s, wall),
+                1000 * stage_seconds(cpu_samples, s, cpu));
+    }
+    fprintf(f, "%-14s %10.1f %10.1f\n", "total", 1000 * wall, 1000 * cpu);
+    for (int c = 0; c < counters; ++c) {
+        fprintf(f, "%-21s %llu\n", name(static_cast<StatCounter>(c)),
+                static_cast<unsigned long long>(counts[c].load()));
+    }
+}
+
+void RunStats::print_json(FILE * f) const {
+    double wall = wall_seconds();
+    double cpu = cpu_seconds();
+    fprintf(f, "{\"wall_ms\":%.3f,\"cpu_ms\":%.3f,\"stages\":{", 1000 * wall, 1000 * cpu);
+    for (int s = 0; s < stages; ++s) {
+        fprintf(f, "%s\"%s\":{\"wall_ms\":%.3f,\"cpu_ms\":%.3f}", s ? "," : "",
+                name(static_cast<Stage>(s)),
+                1000 * stage_seconds(wall_samples, s, wall),
+                1000 * stage_seconds(cpu_samples, s, cpu));
+    }
+    fprintf(f, "},\"counters\":{");
+    for (int c = 0; c < counters; ++c) {
+        fprintf(f, "%s\"%s\":%llu", c ? "," : "", name(static_cast<StatCounter>(c)),
+                static_cast<unsigned long long>(counts[c].load()));
+    }
+    fprintf(f, "}}\n");
+}
+
+bool report_stats(bool text, char const * json_name) {
+    run_stats.stop();
+    if (text) {
+        run_stats.print(stderr);
+    }
+    if (json_name) {
+        FILE * f = fopen(json_name, "w");
+        if (!f) {
+            fprintf(stderr, "can't write %s\n", json_name);
+            return false;
+        }
+        run_stats.print_json(f);
+        return fclose(f) == 0;
+    }
+    return true;
+}
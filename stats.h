@@ -0,0 +1,206 @@
+#ifndef stats_h
+#define stats_h
+
+// Per-stage timing and counters for --stats.
+//
+// Code marks the stage it is in with a StatsStage scope and bumps counters
+// with stats_count(). Both are a single well-predicted branch while stats are
+// off, and compile to nothing when built with SB_NO_STATS. Time per stage is
+// sampled rather than measured at every transition: a sampler thread reads
+// the current stage for wall time and SIGPROF does the same for CPU time, so
+// tagging a stage costs one store even for tiny stages like keyword lookup.
+//
+// The current stage is kept per thread. The sampler takes one sample per
+// thread that is inside a stage, so with several threads counting, wall time
+// is split in proportion to thread time; SIGPROF lands on the thread using
+// the CPU and reads that thread's stage. The thread that called start()
+// counts as "other" outside any stage, the others only count inside one.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <thread>
+
+enum class Stage : int {
+    other, tokenize, keyword, group, classify, syllables, transliterate, output,
+    count
+};
+
+enum class StatCounter : int {
+    bytes, keywords, groups, skipped_destinations, lines, verses, allocations, arena_peak_bytes,
+    count
+};
+
+// which slot of RunStats::thread_stage a thread uses, for the run numbered
+// generation; the slot is null once all are taken
+struct StatsThread {
+    unsigned generation;
+    std::atomic<int> * slot;
+};
+
+inline StatsThread & stats_thread() {
+    static thread_local StatsThread t = {0, nullptr};
+    return t;
+}
+
+class RunStats {
+public:
+    static const int stages = static_cast<int>(Stage::count);
+    static const int counters = static_cast<int>(StatCounter::count);
+    static const int max_threads = 64;
+
+    // set by start() and stop() on one thread, read everywhere else with
+    // relaxed loads; counts racing a start or stop may be lost
+    std::atomic<bool> enabled{false};
+
+    ~RunStats() {
+        stop();
+    }
+
+    // starts sampling; counters and stages are recorded from now on
+    // (a restart discards what the previous run collected)
+    void start();
+    void stop();
+
+    void add(StatCounter c, std::uint64_t n) {
+        counts[static_cast<int>(c)].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // memory reserved by arenas grew or shrank; keeps the peak in arena_peak_bytes
+    void arena_change(std::int64_t delta) {
+        std::int64_t now = arena_live.fetch_add(delta, std::memory_order_relaxed) + delta;
+        if (now <= 0) return;
+        auto & peak = counts[static_cast<int>(StatCounter::arena_peak_bytes)];
+        std::uint64_t old = peak.load(std::memory_order_relaxed);
+        while (static_cast<std::uint64_t>(now) > old
+               && !peak.compare_exchange_weak(old, static_cast<std::uint64_t>(now))) {
+        }
+    }
+
+    std::uint64_t get(StatCounter c) const {
+        return counts[static_cast<int>(c)].load(std::memory_order_relaxed);
+    }
+
+    // wall time attributed to a stage by the last start()..stop()
+    double stage_wall_seconds(Stage s) const {
+        return stage_seconds(wall_samples, static_cast<int>(s), wall_seconds());
+    }
+
+    void print(FILE * f) const;
+    void print_json(FILE * f) const;
+
+    static char const * name(Stage s);
+    static char const * name(StatCounter c);
+
+    // this thread's stage for this run, claimed on first use; null for
+    // threads past max_threads, which go unsampled
+    std::atomic<int> * thread_slot() {
+        StatsThread & t = stats_thread();
+        unsigned g = generation.load(std::memory_order_relaxed);
+        if (t.generation != g) {
+            int i = threads.fetch_add(1, std::memory_order_relaxed);
+            t.slot = i < max_threads ? &thread_stage[i] : nullptr;
+            t.generation = g;
+        }
+        return t.slot;
+    }
+
+    // called from the SIGPROF handler, on the thread that was running
+    void cpu_sample() {
+        StatsThread const & t = stats_thread();
+        int s = t.slot && t.generation == generation.load(std::memory_order_relaxed)
+              ? t.slot->load(std::memory_order_relaxed) : 0;
+        cpu_samples[s < 0 ? 0 : s].fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<std::uint64_t> counts[counters] = {};
+    std::atomic<std::uint64_t> wall_samples[stages] = {};
+    std::atomic<std::uint64_t> cpu_samples[stages] = {};
+    std::atomic<std::int64_t> arena_live{0};
+    std::atomic<int> thread_stage[max_threads] = {};    // -1 outside any stage
+    std::atomic<int> threads{0};
+    std::atomic<unsigned> generation{0};
+    std::atomic<bool> stopping{false};
+    std::thread sampler;
+    std::chrono::steady_clock::time_point wall_start, wall_end;
+    std::clock_t cpu_start = 0, cpu_end = 0;
+
+    double stage_seconds(std::atomic<std::uint64_t> const (&samples)[stages], int s, double total) const;
+    double wall_seconds() const;
+    double cpu_seconds() const;
+};
+
+extern RunStats run_stats;
+
+// Stops collection and prints the table to stderr (text) and/or the JSON
+// dump to json_name. False if the JSON file can't be written.
+bool report_stats(bool text, char const * json_name);
+
+inline void stats_count(StatCounter c, std::uint64_t n = 1) {
+#ifndef SB_NO_STATS
+    if (run_stats.enabled.load(std::memory_order_relaxed)) run_stats.add(c, n);
+#else
+    (void)c; (void)n;
+#endif
+}
+
+inline void stats_arena(std::int64_t delta) {
+#ifndef SB_NO_STATS
+    if (run_stats.enabled.load(std::memory_order_relaxed)) run_stats.arena_change(delta);
+#else
+    (void)delta;
+#endif
+}
+
+// Attributes time to a stage for the lifetime of the object; nests.
+class StatsStage {
+public:
+    explicit StatsStage(Stage s) {
+#ifndef SB_NO_STATS
+        enter(static_cast<int>(s));
+#else
+        (void)s;
+#endif
+    }
+
+    ~StatsStage() {
+#ifndef SB_NO_STATS
+        if (slot) slot->store(prev, std::memory_order_relaxed);
+#endif
+    }
+
+    StatsStage(StatsStage const &) = delete;
+    StatsStage & operator=(StatsStage const &) = delete;
+
+protected:
+    StatsStage() = default;
+
+#ifndef SB_NO_STATS
+    void enter(int s) {
+        if (run_stats.enabled.load(std::memory_order_relaxed)) {
+            slot = run_stats.thread_slot();
+            if (slot) prev = slot->exchange(s, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    std::atomic<int> * slot = nullptr;
+    int prev = -1;
+#endif
+};
+
+// Leaves the thread out of the wall time samples for the lifetime of the
+// object, e.g. while it only waits for other threads to count.
+class StatsIdle : public StatsStage {
+public:
+    StatsIdle() {
+#ifndef SB_NO_STATS
+        enter(-1);
+#endif
+    }
+};
+
+#endif
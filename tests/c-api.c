@@ -0,0 +1,113 @@
+/* The C API (sbcount.h), from C.
+ *
+ *   c-api <bhagpur.itx>
+ *
+ * Counts the file through sb_count_file and prints the chapter and overall
+ * totals as sb-itx-sloka-counter --totals-only does, so that c-api.cmake can
+ * compare the two. Along the way it checks that a short verse array gives
+ * SB_ERROR_TRUNCATED with the full count, that the verses add up to the
+ * totals, that sb_count_buffer agrees with sb_count_file and that a missing
+ * file is SB_ERROR_READ. Those failures go to stderr and exit 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sbcount.h"
+
+static int failures = 0;
+
+static void check(int ok, char const * what, sb_context const * ctx) {
+    if (!ok) {
+        fprintf(stderr, "FAIL %s (%s)\n", what, sb_last_error(ctx));
+        ++failures;
+    }
+}
+
+static char * read_file(char const * name, size_t * size) {
+    FILE * f = fopen(name, "rb");
+    char * data;
+    long n;
+    if (!f) return NULL;
+    if (fseek(f, 0, SEEK_END) != 0 || (n = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0) {
+        fclose(f);
+        return NULL;
+    }
+    data = (char *)malloc((size_t)n + 1);
+    if (data) *size = fread(data, 1, (size_t)n, f);
+    fclose(f);
+    return data;
+}
+
+int main(int argc, char * argv[]) {
+    sb_context * ctx;
+    sb_verse * verses;
+    sb_chapter * chapters;
+    sb_totals totals, again;
+    size_t verse_count = 0, found = 0, chapter_count = 0, i, size = 0;
+    long long syllables = 0, syllables_no_uvaca = 0;
+    char * data;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: c-api <bhagpur.itx>\n");
+        return 2;
+    }
+    ctx = sb_context_new(SB_INPUT_ITX);
+    if (!ctx) return 2;
+
+    /* sized by a first call without an array */
+    check(sb_count_file(ctx, argv[1], NULL, 0, &verse_count, &totals) == SB_ERROR_TRUNCATED,
+          "count without an array is truncated", ctx);
+    check(verse_count > 1 && verse_count == totals.verses, "verse count", ctx);
+    verses = (sb_verse *)malloc((verse_count + 1) * sizeof(sb_verse));
+    if (!verses) return 2;
+    check(sb_count_file(ctx, argv[1], verses, verse_count - 1, &found, NULL) == SB_ERROR_TRUNCATED,
+          "one verse short is truncated", ctx);
+    check(found == verse_count, "truncated count is the full count", ctx);
+    check(sb_count_file(ctx, argv[1], verses, verse_count + 1, &found, &totals) == SB_OK,
+          "count into a large enough array", ctx);
+    check(found == verse_count, "verse count again", ctx);
+    for (i = 0; i < found; ++i) {
+        syllables += verses[i].syllables;
+        syllables_no_uvaca += verses[i].syllables_no_uvaca;
+    }
+    check(syllables == totals.syllables && syllables_no_uvaca == totals.syllables_no_uvaca,
+          "verses add up to the totals", ctx);
+
+    data = read_file(argv[1], &size);
+    if (data) {
+        check(sb_count_buffer(ctx, data, size, NULL, 0, NULL, &again) == SB_ERROR_TRUNCATED
+              && again.syllables == totals.syllables && again.verses == totals.verses,
+              "sb_count_buffer agrees with sb_count_file", ctx);
+        free(data);
+    } else {
+        check(0, "read the file", ctx);
+    }
+    check(sb_count_file(ctx, "no such file.itx", NULL, 0, NULL, NULL) == SB_ERROR_READ,
+          "missing file", ctx);
+    check(sb_last_error(ctx)[0] != '\0', "missing file has a message", ctx);
+
+    /* sb_chapters reports the last successful count */
+    check(sb_count_file(ctx, argv[1], verses, verse_count, NULL, &totals) == SB_OK, "count", ctx);
+    check(sb_chapters(ctx, NULL, 0, &chapter_count) == SB_ERROR_TRUNCATED && chapter_count > 0,
+          "chapter count", ctx);
+    chapters = (sb_chapter *)malloc(chapter_count * sizeof(sb_chapter));
+    if (!chapters) return 2;
+    check(sb_chapters(ctx, chapters, chapter_count, &found) == SB_OK && found == chapter_count,
+          "chapters", ctx);
+    for (i = 0; i < chapter_count; ++i) {
+        if (chapters[i].chapter == 0) {
+            printf("chapter %02d.x: %d\n", (int)chapters[i].canto, (int)chapters[i].syllables);
+        } else {
+            printf("chapter %02d.%02d: %d\n", (int)chapters[i].canto, (int)chapters[i].chapter,
+                   (int)chapters[i].syllables);
+        }
+    }
+    printf("total syllables: %lld\n", (long long)totals.syllables);
+    printf("total syllables (no uvaaca): %lld\n", (long long)totals.syllables_no_uvaca);
+
+    free(chapters);
+    free(verses);
+    sb_context_free(ctx);
+    return failures == 0 ? 0 : 1;
+}
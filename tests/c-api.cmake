@@ -0,0 +1,18 @@
+# The c-api test: its report of bhagpur.itx through the C API must be the
+# one sb-itx-sloka-counter --totals-only prints.
+#
+#   cmake -DAPI=<c-api> -DCOUNTER=<sb-itx-sloka-counter> -DITX=<bhagpur.itx> -P c-api.cmake
+
+execute_process(COMMAND ${API} ${ITX} RESULT_VARIABLE api_result OUTPUT_VARIABLE api_report)
+if (NOT api_result EQUAL 0)
+    message(FATAL_ERROR "c-api failed: ${api_result}")
+endif()
+execute_process(COMMAND ${COUNTER} --totals-only ${ITX} RESULT_VARIABLE counter_result
+    OUTPUT_VARIABLE counter_report)
+if (NOT counter_result EQUAL 0)
+    message(FATAL_ERROR "sb-itx-sloka-counter failed: ${counter_result}")
+endif()
+if (NOT api_report STREQUAL counter_report)
+    message(FATAL_ERROR "C API totals differ from sb-itx-sloka-counter --totals-only:\n"
+        "${api_report}\n---\n${counter_report}")
+endif()
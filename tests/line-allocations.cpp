@@ -0,0 +1,159 @@
+// Heap allocations in the counters' steady state.
+//
+//   line-allocations <bhagpur.itx> <corpus.rtf>
+//
+// Counts both files with line output (to the null device) and meters on,
+// counting every operator new from the first line of the second chapter to
+// the end of the input. Anything above zero fails, with the verse it
+// happened in.
+// Built with SB_NO_STATS so that the operator new here is the only one.
+
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <new>
+#include <string>
+
+#include "rtfparser.h"
+#include "sb-itx-sloka-counter.h"
+#include "sb-sloka-counter.h"
+#include "verse.h"
+
+#ifdef _WIN32
+#include <io.h>
+static char const null_device[] = "NUL";
+#else
+#include <unistd.h>
+static char const null_device[] = "/dev/null";
+#endif
+
+static bool counting = false;
+static unsigned long allocations = 0;
+
+// The heap behind the operators below, kept out of line: once GCC inlines
+// malloc and free into operator new and delete it pairs them up at the call
+// sites and warns of mismatched new and free (-Wmismatched-new-delete).
+#if defined(_MSC_VER)
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE __attribute__((noinline))
+#endif
+
+NOINLINE static void * heap_allocate(std::size_t size) {
+    return std::malloc(size ? size : 1);
+}
+
+NOINLINE static void heap_release(void * p) {
+    std::free(p);
+}
+
+void * operator new(std::size_t size) {
+    if (counting) ++allocations;
+    for (;;) {
+        if (void * p = heap_allocate(size)) return p;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void * operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void * p) noexcept {
+    heap_release(p);
+}
+
+void operator delete[](void * p) noexcept {
+    heap_release(p);
+}
+
+// Line sink: turns counting on at the second chapter and notes the verses
+// in which the count went up.
+class AllocationCheck {
+public:
+    explicit AllocationCheck(char const * name) : name_(name) {}
+
+    void line(std::uint32_t id) {
+        std::uint32_t chapter = id >> 16;
+        if (first_chapter == 0) first_chapter = chapter;
+        if (!counting && chapter != first_chapter) {
+            counting = true;
+            allocations = 0;
+        }
+        if (!counting) return;
+        ++lines;
+        if (allocations != seen) {
+            if (reported < 10) {
+                printf("%s: %lu allocation(s) before the line of %s\n", name_,
+                       allocations - seen, verse_id_to_string(id).c_str());
+                ++reported;
+            }
+            seen = allocations;
+        }
+    }
+
+    // stops counting; false if anything allocated
+    bool finish() {
+        counting = false;
+        printf("%s: %lu allocations in %lu lines after the first chapter\n", name_, allocations, lines);
+        return lines > 0 && allocations == 0;
+    }
+
+private:
+    char const * name_;
+    std::uint32_t first_chapter = 0;
+    unsigned long lines = 0;
+    unsigned long seen = 0;
+    int reported = 0;
+};
+
+template <class Counter>
+static void watch(Counter & c, AllocationCheck & check, int fd) {
+    c.set_output_fd(fd);
+    c.set_show_meters(true);
+    c.set_line_sink([&check](std::uint32_t id, int, bool, std::string const &) {
+        check.line(id);
+    });
+}
+
+int main(int argc, char * argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: line-allocations <bhagpur.itx> <corpus.rtf>\n");
+        return 2;
+    }
+    int null_fd = open(null_device, O_WRONLY);
+    bool ok = true;
+    {
+        std::ifstream f(argv[1]);
+        if (!f) {
+            fprintf(stderr, "can't open %s\n", argv[1]);
+            return 2;
+        }
+        AllocationCheck check("itx");
+        SlokaCounter c;
+        watch(c, check, null_fd);
+        c.count(f);
+        ok = check.finish() && ok;
+    }
+    {
+        FILE * f = fopen(argv[2], "rb");
+        if (!f) {
+            fprintf(stderr, "can't open %s\n", argv[2]);
+            return 2;
+        }
+        AllocationCheck check("rtf");
+        RtfParser<SbSlokaCounter> p;
+        watch(p.GetOutputter(), check, null_fd);
+        Status ec = p.RtfParse(f);
+        ok = check.finish() && ok;
+        fclose(f);
+        if (ec != Status::OK) {
+            fprintf(stderr, "error %d parsing %s\n", int(ec), argv[2]);
+            return 2;
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+// --format ndjson output of text that is not valid UTF-8.
+//
+//   report-writer <scratch file>
+//
+// Writes lines and a file name holding stray, overlong, surrogate and cut
+// short sequences as ndjson, then checks that every bad byte came out as
+// \ufffd, that well-formed IAST went through unchanged and that the whole
+// report is valid UTF-8.
+
+#include <cstdint>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "report-writer.h"
+
+static int failures = 0;
+
+static void check(bool ok, std::string const & what) {
+    if (!ok) {
+        printf("FAIL %s\n", what.c_str());
+        ++failures;
+    }
+}
+
+static std::string read_file(char const * name) {
+    std::ifstream f(name, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+}
+
+static int create_file(char const * name) {
+#ifdef _WIN32
+    return _open(name, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    return open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+}
+
+static void close_file(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+// decodes s by the book rather than the way report-writer.h checks it
+static bool valid_utf8(std::string const & s) {
+    std::size_t i = 0;
+    while (i < s.size()) {
+        auto lead = static_cast<unsigned char>(s[i]);
+        std::size_t n;
+        std::uint32_t cp;
+        std::uint32_t min;
+        if (lead < 0x80) { n = 1; cp = lead; min = 0; }
+        else if ((lead & 0xe0) == 0xc0) { n = 2; cp = lead & 0x1fu; min = 0x80; }
+        else if ((lead & 0xf0) == 0xe0) { n = 3; cp = lead & 0x0fu; min = 0x800; }
+        else if ((lead & 0xf8) == 0xf0) { n = 4; cp = lead & 0x07u; min = 0x10000; }
+        else return false;
+        if (i + n > s.size()) return false;
+        for (std::size_t k = 1; k < n; ++k) {
+            auto b = static_cast<unsigned char>(s[i + k]);
+            if ((b & 0xc0) != 0x80) return false;
+            cp = cp << 6 | (b & 0x3fu);
+        }
+        if (cp < min || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) return false;
+        i += n;
+    }
+    return true;
+}
+
+struct Case {
+    char const * text;
+    char const * json;      // what ndjson must give for it, quotes included
+};
+
+int main(int argc, char * argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: report-writer <scratch file>\n");
+        return 2;
+    }
+    static Case const cases[] = {
+        {"k\xc4\x81ma", "\"k\xc4\x81ma\""},                             // a with macron
+        {"\xe1\xb9\x9bta \xf0\x9f\x95\x89", "\"\xe1\xb9\x9bta \xf0\x9f\x95\x89\""},
+        {"a\xff" "b", "\"a\\ufffdb\""},
+        {"\x80\xbf", "\"\\ufffd\\ufffd\""},                             // stray continuations
+        {"k\xc4", "\"k\\ufffd\""},                                      // cut short at the end
+        {"\xe1\xb9" "a", "\"\\ufffd\\ufffda\""},                        // cut short before ASCII
+        {"\xc0\xaf", "\"\\ufffd\\ufffd\""},                             // overlong '/'
+        {"\xe0\x80\xaf", "\"\\ufffd\\ufffd\\ufffd\""},                  // overlong '/'
+        {"\xed\xa0\x80", "\"\\ufffd\\ufffd\\ufffd\""},                  // surrogate
+        {"\xf4\x90\x80\x80", "\"\\ufffd\\ufffd\\ufffd\\ufffd\""},       // past U+10FFFF
+        {"\"\\\x01", "\"\\\"\\\\\\u0001\""},
+    };
+
+    int fd = create_file(argv[1]);
+    if (fd < 0) {
+        fprintf(stderr, "report-writer: can't create %s\n", argv[1]);
+        return 2;
+    }
+    std::vector<std::string> texts;
+    for (auto & c: cases) texts.push_back(c.text);
+    {
+        ReportWriter writer(ReportFormat::ndjson, fd);
+        writer.file("bad\xfe.itx");
+        std::uint32_t id = 1;
+        for (auto & text: texts) {
+            ReportLine line = {id, id, 8, false, &text, nullptr, nullptr};
+            writer.line(line);
+            ++id;
+        }
+        writer.flush();
+        check(!writer.failed(), "report written");
+    }
+    close_file(fd);
+
+    std::string report = read_file(argv[1]);
+    check(valid_utf8(report), "report is valid UTF-8");
+    check(report.find("\"file\":\"bad\\ufffd.itx\"") != std::string::npos, "file name");
+    for (auto & c: cases) {
+        std::string field = std::string(",\"text\":") + c.json + "}\n";
+        check(report.find(field) != std::string::npos, std::string("text ") + c.json);
+    }
+
+    std::remove(argv[1]);
+    printf("%zu strings written, %d failures\n", texts.size() + 1, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+// --emit-binary files read back through VerseColumnsReader.
+//
+//   verse-columns <bhagpur.itx> <scratch file>
+//
+// Writes the per-line results of bhagpur.itx as the counters do, checks
+// that every row reads back the same, then that truncated and corrupted
+// copies are refused with std::runtime_error rather than read out of bounds.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "sb-itx-sloka-counter.h"
+#include "verse-columns.h"
+
+struct Row {
+    std::uint32_t id;
+    int syllables;
+    bool uvaca;
+    std::string text;
+};
+
+static int failures = 0;
+
+static void check(bool ok, std::string const & what) {
+    if (!ok) {
+        printf("FAIL %s\n", what.c_str());
+        ++failures;
+    }
+}
+
+static std::string read_file(char const * name) {
+    std::ifstream f(name, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+}
+
+static void write_file(char const * name, std::string const & bytes) {
+    std::ofstream f(name, std::ios::binary | std::ios::trunc);
+    f.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+template <class T>
+static void poke(std::string & bytes, std::uint64_t offset, T value) {
+    std::memcpy(&bytes[static_cast<std::size_t>(offset)], &value, sizeof(value));
+}
+
+// bytes written to scratch must not open
+static void expect_refused(char const * scratch, std::string const & bytes, std::string const & what) {
+    write_file(scratch, bytes);
+    try {
+        VerseColumnsReader r(scratch);
+        check(false, what + ": accepted");
+    } catch (std::runtime_error const &) {
+    }
+}
+
+int main(int argc, char * argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: verse-columns <bhagpur.itx> <scratch file>\n");
+        return 2;
+    }
+    char const * scratch = argv[2];
+
+    std::vector<Row> rows;
+    VerseColumnsWriter writer;
+    {
+        std::ifstream f(argv[1]);
+        if (!f) {
+            fprintf(stderr, "can't open %s\n", argv[1]);
+            return 2;
+        }
+        SlokaCounter c;
+        c.set_print_lines(false);
+        c.set_line_sink([&](std::uint32_t id, int syllables, bool uvaca, std::string const & text) {
+            rows.push_back(Row{id, syllables, uvaca, text});
+            writer.add(id, syllables, uvaca, text);
+        });
+        c.count(f);
+    }
+    if (!writer.write(scratch)) {
+        fprintf(stderr, "can't write %s\n", scratch);
+        return 2;
+    }
+
+    {
+        VerseColumnsReader r(scratch);
+        check(r.size() == rows.size(), "row count");
+        for (std::size_t i = 0; i < rows.size() && i < r.size(); ++i) {
+            Row const & row = rows[i];
+            if (r.id(i) != row.id || r.syllables(i) != row.syllables || r.uvaca(i) != row.uvaca
+                    || std::string(r.text_data(i), r.text_size(i)) != row.text) {
+                check(false, "row " + std::to_string(i));
+                break;
+            }
+        }
+    }
+
+    std::string good = read_file(scratch);
+    VerseColumnsHeader h;
+    std::memcpy(&h, good.data(), sizeof(h));
+    std::uint64_t offsets[] = {h.id_offset, h.syllables_offset, h.uvaca_offset, h.text_offset_offset, h.blob_offset};
+
+    std::vector<std::uint64_t> cuts = {0, sizeof(h) - 1, sizeof(h), good.size() - 1};
+    for (auto offset: offsets) {
+        cuts.push_back(offset);
+        cuts.push_back(offset + 1);
+    }
+    for (auto cut: cuts) {
+        expect_refused(scratch, good.substr(0, static_cast<std::size_t>(cut)),
+                       "truncated to " + std::to_string(cut));
+    }
+
+    std::uint64_t const huge = ~std::uint64_t(0);
+    std::string bad = good;
+    bad[0] = 'X';
+    expect_refused(scratch, bad, "bad magic");
+    bad = good;
+    poke(bad, offsetof(VerseColumnsHeader, version), std::uint32_t(99));
+    expect_refused(scratch, bad, "bad version");
+    bad = good;
+    poke(bad, offsetof(VerseColumnsHeader, header_size), std::uint32_t(8));
+    expect_refused(scratch, bad, "bad header size");
+    for (auto rows_value: {huge, huge / 2, std::uint64_t(good.size())}) {
+        bad = good;
+        poke(bad, offsetof(VerseColumnsHeader, rows), rows_value);
+        expect_refused(scratch, bad, "rows " + std::to_string(rows_value));
+    }
+    // each offset field and the width of what it points to
+    struct { std::size_t field; std::uint64_t width; } const fields[] = {
+        {offsetof(VerseColumnsHeader, id_offset), 4},
+        {offsetof(VerseColumnsHeader, syllables_offset), 2},
+        {offsetof(VerseColumnsHeader, uvaca_offset), 1},
+        {offsetof(VerseColumnsHeader, text_offset_offset), 8},
+        {offsetof(VerseColumnsHeader, blob_offset), 1},
+    };
+    for (auto & f: fields) {
+        std::vector<std::uint64_t> values = {huge, std::uint64_t(good.size()) + 8, 0};
+        if (f.width > 1) values.push_back(sizeof(h) + 1);
+        for (auto value: values) {
+            bad = good;
+            poke(bad, f.field, value);
+            expect_refused(scratch, bad, "header field at " + std::to_string(f.field) + " = " + std::to_string(value));
+        }
+    }
+    bad = good;
+    poke(bad, h.text_offset_offset + 8 * 100, huge);
+    expect_refused(scratch, bad, "text offset out of order");
+    bad = good;
+    poke(bad, h.text_offset_offset + 8 * h.rows, good.size());
+    expect_refused(scratch, bad, "text past the end");
+
+    std::remove(scratch);
+    printf("%zu rows read back, %d failures\n", rows.size(), failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+// --index files read back through VerseIndexReader.
+//
+//   verse-index <bhagpur.itx> <scratch file>
+//
+// Indexes bhagpur.itx as the counters do, checks documents and a few
+// queries against a plain scan of the folded text, then that truncated and
+// corrupted copies are refused with std::runtime_error rather than read out
+// of bounds.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "sb-itx-sloka-counter.h"
+#include "verse-index.h"
+
+static int failures = 0;
+
+static void check(bool ok, std::string const & what) {
+    if (!ok) {
+        printf("FAIL %s\n", what.c_str());
+        ++failures;
+    }
+}
+
+static std::string read_file(char const * name) {
+    std::ifstream f(name, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+}
+
+static void write_file(char const * name, std::string const & bytes) {
+    std::ofstream f(name, std::ios::binary | std::ios::trunc);
+    f.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+template <class T>
+static void poke(std::string & bytes, std::uint64_t offset, T value) {
+    std::memcpy(&bytes[static_cast<std::size_t>(offset)], &value, sizeof(value));
+}
+
+template <class T>
+static T peek(std::string const & bytes, std::uint64_t offset) {
+    T value;
+    std::memcpy(&value, &bytes[static_cast<std::size_t>(offset)], sizeof(value));
+    return value;
+}
+
+// bytes written to scratch must not open
+static void expect_refused(char const * scratch, std::string const & bytes, std::string const & what) {
+    write_file(scratch, bytes);
+    try {
+        VerseIndexReader r(scratch);
+        check(false, what + ": accepted");
+    } catch (std::runtime_error const &) {
+    }
+}
+
+int main(int argc, char * argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: verse-index <bhagpur.itx> <scratch file>\n");
+        return 2;
+    }
+    char const * scratch = argv[2];
+
+    // documents as the writer should group them
+    std::vector<std::uint32_t> ids;
+    std::vector<std::string> texts;
+    VerseIndexWriter writer;
+    {
+        std::ifstream f(argv[1]);
+        if (!f) {
+            fprintf(stderr, "can't open %s\n", argv[1]);
+            return 2;
+        }
+        SlokaCounter c;
+        c.set_print_lines(false);
+        c.set_line_sink([&](std::uint32_t id, int, bool, std::string const & text) {
+            if (ids.empty() || ids.back() != id) {
+                ids.push_back(id);
+                texts.push_back(text);
+            } else {
+                texts.back() += '\n' + text;
+            }
+            writer.add(id, text);
+        });
+        c.count(f);
+    }
+    if (!writer.write(scratch)) {
+        fprintf(stderr, "can't write %s\n", scratch);
+        return 2;
+    }
+
+    {
+        VerseIndexReader r(scratch);
+        check(r.size() == ids.size(), "document count");
+        for (std::size_t doc = 0; doc < ids.size() && doc < r.size(); ++doc) {
+            if (r.id(doc) != ids[doc] || std::string(r.text_data(doc), r.text_size(doc)) != texts[doc]) {
+                check(false, "document " + std::to_string(doc));
+                break;
+            }
+        }
+        for (std::string query: {"dharma", "śrī-śuka uvāca", "yato 'nvayād", "ka", "no such verse xyz"}) {
+            std::string q;
+            fold_for_search(query.data(), query.data() + query.size(), q);
+            std::vector<std::size_t> expected;
+            for (std::size_t doc = 0; doc < r.size(); ++doc) {
+                if (std::string(r.folded_data(doc), r.folded_size(doc)).find(q) != std::string::npos) {
+                    expected.push_back(doc);
+                }
+            }
+            check(r.find(query) == expected, "query \"" + query + "\"");
+        }
+    }
+
+    std::string good = read_file(scratch);
+    VerseIndexHeader h;
+    std::memcpy(&h, good.data(), sizeof(h));
+    std::uint64_t postings_pos = binary_align(h.posting_offset_offset + (std::uint64_t(h.trigrams) + 1) * 8);
+
+    std::vector<std::uint64_t> cuts = {0, sizeof(h) - 1, sizeof(h), postings_pos, good.size() - 1};
+    for (auto offset: {h.id_offset, h.text_offset_offset, h.fold_offset_offset, h.trigram_offset,
+                       h.posting_offset_offset}) {
+        cuts.push_back(offset + 1);
+    }
+    for (auto cut: cuts) {
+        expect_refused(scratch, good.substr(0, static_cast<std::size_t>(cut)),
+                       "truncated to " + std::to_string(cut));
+    }
+
+    std::uint64_t const huge = ~std::uint64_t(0);
+    std::string bad = good;
+    bad[0] = 'X';
+    expect_refused(scratch, bad, "bad magic");
+    bad = good;
+    poke(bad, offsetof(VerseIndexHeader, version), std::uint32_t(99));
+    expect_refused(scratch, bad, "bad version");
+    for (auto field: {offsetof(VerseIndexHeader, docs), offsetof(VerseIndexHeader, trigrams)}) {
+        bad = good;
+        poke(bad, field, ~std::uint32_t(0));
+        expect_refused(scratch, bad, "count at " + std::to_string(field));
+    }
+    for (auto field: {offsetof(VerseIndexHeader, id_offset), offsetof(VerseIndexHeader, text_offset_offset),
+                      offsetof(VerseIndexHeader, fold_offset_offset), offsetof(VerseIndexHeader, trigram_offset),
+                      offsetof(VerseIndexHeader, posting_offset_offset)}) {
+        for (auto value: {huge, std::uint64_t(good.size()) + 8, std::uint64_t(0), std::uint64_t(sizeof(h) + 2)}) {
+            bad = good;
+            poke(bad, field, value);
+            expect_refused(scratch, bad, "header field at " + std::to_string(field) + " = " + std::to_string(value));
+        }
+    }
+    bad = good;
+    poke(bad, h.posting_offset_offset + 8 * h.trigrams, huge / 8);
+    expect_refused(scratch, bad, "postings past the end");
+    bad = good;
+    poke(bad, h.posting_offset_offset + 8 * 10, huge);
+    expect_refused(scratch, bad, "posting offsets out of order");
+    bad = good;
+    poke(bad, h.text_offset_offset + 8 * h.docs, std::uint64_t(good.size()));
+    expect_refused(scratch, bad, "text past the end");
+    bad = good;
+    poke(bad, h.fold_offset_offset + 8 * 10, huge);
+    expect_refused(scratch, bad, "folded offsets out of order");
+    bad = good;
+    poke(bad, postings_pos, h.docs);
+    expect_refused(scratch, bad, "posting of a document that doesn't exist");
+    bad = good;
+    poke(bad, h.trigram_offset + 4, peek<std::uint32_t>(good, h.trigram_offset));
+    expect_refused(scratch, bad, "trigrams out of order");
+
+    std::remove(scratch);
+    printf("%zu documents read back, %d failures\n", ids.size(), failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,595 @@
+#ifndef utf8_syllables_h
+#define utf8_syllables_h
+
+// Syllable counting straight on UTF-8 text: IAST, precomposed or with
+// combining marks, and Devanagari. The rules are those of
+// encoded_syllables<ItransEncoding> (encodings.h), so IAST or Devanagari text gives the
+// same counts and light/heavy patterns as its ITRANS original.
+//
+// Letters are classified through tables indexed by code point. Runs of
+// ASCII, which is most of IAST, are found 16 bytes at a time; they and the
+// precomposed IAST letters go through a branch-free step that keeps the
+// syllable state in registers. Devanagari and combining marks, which depend
+// on the letters around them, are handled one at a time.
+//
+// Whether a syllable is heavy depends on the consonants since the vowel
+// before, so that step is a chain through every letter. Counting alone, for
+// when meters aren't shown, only needs the vowels: utf8_syllable_count
+// takes 16 bytes at a time of anything but combining marks and Devanagari.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SB_UTF8_SSE2 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#include "meter.h"
+#include "stats.h"
+
+enum class Utf8Letter : unsigned char {
+    other,
+    consonant,
+    aspirable,          // consonant that takes a following h as aspiration (kh, ṭh...)
+    h,
+    x,                  // kṣ in ITRANS style text
+    a,                  // a, or the start of ai/au
+    short_vowel,
+    long_vowel,
+    heavy,              // anusvara, visarga, candrabindu
+    // the rest depend on the letters around them
+    deva_consonant,     // with an inherent a unless a sign or virama follows
+    deva_short_sign,
+    deva_long_sign,
+    virama,
+    mark,               // leaves the letter before it as it was (nukta, accents...)
+    macron,             // combining marks that change the IAST letter before them
+    dot_below,
+    dot_above,
+    count
+};
+
+class Utf8LetterTable {
+public:
+    // What a letter does to the syllable state in the branch-free step;
+    // the low two bits are the consonants it adds.
+    static const unsigned act_vowel = 4, act_long = 8, act_a = 16, act_h = 32,
+        act_aspirable = 64, act_heavy = 128;
+
+    Utf8LetterTable() {
+        for (auto & c: latin) c = Utf8Letter::other;
+        for (auto & c: combining) c = Utf8Letter::mark;
+        for (auto & c: deva) c = Utf8Letter::other;
+        for (auto & c: latin_additional) c = Utf8Letter::other;
+
+        for (char const * p = "flmnqrsvwyz"; *p; ++p) both_cases(*p, Utf8Letter::consonant);
+        for (char const * p = "bcdgjkpt"; *p; ++p) both_cases(*p, Utf8Letter::aspirable);
+        for (char const * p = "iu"; *p; ++p) both_cases(*p, Utf8Letter::short_vowel);
+        for (char const * p = "eo"; *p; ++p) both_cases(*p, Utf8Letter::long_vowel);
+        both_cases('a', Utf8Letter::a);
+        both_cases('h', Utf8Letter::h);
+        both_cases('x', Utf8Letter::x);
+
+        // capital and small letter pairs
+        latin_pair(0x100, Utf8Letter::long_vowel);          // ā
+        latin_pair(0x112, Utf8Letter::long_vowel);          // ē
+        latin_pair(0x12a, Utf8Letter::long_vowel);          // ī
+        latin_pair(0x14c, Utf8Letter::long_vowel);          // ō
+        latin_pair(0x15a, Utf8Letter::consonant);           // ś
+        latin_pair(0x16a, Utf8Letter::long_vowel);          // ū
+        latin[0xd1] = latin[0xf1] = Utf8Letter::consonant;  // ñ
+        additional_pair(0x1e0c, Utf8Letter::aspirable);     // ḍ
+        additional_pair(0x1e24, Utf8Letter::heavy);         // ḥ
+        additional_pair(0x1e36, Utf8Letter::short_vowel);   // ḷ
+        additional_pair(0x1e38, Utf8Letter::long_vowel);    // ḹ
+        additional_pair(0x1e40, Utf8Letter::heavy);         // ṁ
+        additional_pair(0x1e42, Utf8Letter::heavy);         // ṃ
+        additional_pair(0x1e44, Utf8Letter::consonant);     // ṅ
+        additional_pair(0x1e46, Utf8Letter::consonant);     // ṇ
+        additional_pair(0x1e5a, Utf8Letter::short_vowel);   // ṛ
+        additional_pair(0x1e5c, Utf8Letter::long_vowel);    // ṝ
+        additional_pair(0x1e62, Utf8Letter::consonant);     // ṣ
+        additional_pair(0x1e6c, Utf8Letter::aspirable);     // ṭ
+
+        combining[0x04] = Utf8Letter::macron;
+        combining[0x07] = Utf8Letter::dot_above;
+        combining[0x23] = Utf8Letter::dot_below;
+        combining[0x25] = Utf8Letter::dot_below;            // ring below, r̥ in ISO 15919
+
+        for (unsigned cp = 0x901; cp <= 0x903; ++cp) deva_set(cp, Utf8Letter::heavy);
+        for (unsigned cp = 0x915; cp <= 0x939; ++cp) deva_set(cp, Utf8Letter::deva_consonant);
+        for (unsigned cp = 0x958; cp <= 0x95f; ++cp) deva_set(cp, Utf8Letter::deva_consonant);
+        for (unsigned cp: {0x905u, 0x907u, 0x909u, 0x90bu, 0x90cu}) deva_set(cp, Utf8Letter::short_vowel);
+        for (unsigned cp: {0x906u, 0x908u, 0x90au, 0x90fu, 0x910u, 0x913u, 0x914u, 0x960u, 0x961u}) {
+            deva_set(cp, Utf8Letter::long_vowel);
+        }
+        for (unsigned cp: {0x93fu, 0x941u, 0x943u, 0x962u}) deva_set(cp, Utf8Letter::deva_short_sign);
+        for (unsigned cp: {0x93eu, 0x940u, 0x942u, 0x944u, 0x947u, 0x948u, 0x94bu, 0x94cu, 0x963u}) {
+            deva_set(cp, Utf8Letter::deva_long_sign);
+        }
+        deva_set(0x94d, Utf8Letter::virama);
+        deva_set(0x93c, Utf8Letter::mark);                  // nukta
+        for (unsigned cp = 0x951; cp <= 0x954; ++cp) deva_set(cp, Utf8Letter::mark);
+
+        for (auto & a: actions) a = 0;
+        action_of(Utf8Letter::consonant) = 1;
+        action_of(Utf8Letter::aspirable) = 1 | act_aspirable;
+        action_of(Utf8Letter::h) = 1 | act_h;
+        action_of(Utf8Letter::x) = 2;
+        action_of(Utf8Letter::a) = act_vowel | act_a;
+        action_of(Utf8Letter::short_vowel) = act_vowel;
+        action_of(Utf8Letter::long_vowel) = act_vowel | act_long;
+        action_of(Utf8Letter::heavy) = act_heavy;
+        for (unsigned c = 0; c < 0x80; ++c) ascii_actions[c] = action_of(latin[c]);
+    }
+
+    Utf8Letter ascii(unsigned char c) const {
+        return latin[c];
+    }
+
+    Utf8Letter operator()(unsigned cp) const {
+        if (cp < 0x180) return latin[cp];
+        if (cp >= 0x300 && cp < 0x370) return combining[cp - 0x300];
+        if (cp >= 0x900 && cp < 0x980) return deva[cp - 0x900];
+        if (cp >= 0x1e00 && cp < 0x1f00) return latin_additional[cp - 0x1e00];
+        if (cp == 0x200c || cp == 0x200d) return Utf8Letter::mark;  // zero width (non-)joiner
+        return Utf8Letter::other;
+    }
+
+    unsigned action(Utf8Letter l) const {
+        return actions[static_cast<int>(l)];
+    }
+
+    // the same for ASCII, in one lookup
+    unsigned ascii_action(unsigned char c) const {
+        return ascii_actions[c & 0x7f];
+    }
+
+    // letters up to heavy go through the branch-free step
+    static bool is_simple(Utf8Letter l) {
+        return l <= Utf8Letter::heavy;
+    }
+
+private:
+    void both_cases(char c, Utf8Letter l) {
+        latin[static_cast<unsigned char>(c)] = l;
+        latin[static_cast<unsigned char>(c - 'a' + 'A')] = l;
+    }
+    void latin_pair(unsigned capital, Utf8Letter l) {
+        latin[capital] = latin[capital + 1] = l;
+    }
+    void additional_pair(unsigned capital, Utf8Letter l) {
+        latin_additional[capital - 0x1e00] = latin_additional[capital - 0x1e00 + 1] = l;
+    }
+    void deva_set(unsigned cp, Utf8Letter l) {
+        deva[cp - 0x900] = l;
+    }
+    unsigned char & action_of(Utf8Letter l) {
+        return actions[static_cast<int>(l)];
+    }
+
+    Utf8Letter latin[0x180];                // U+0000..U+017F: ASCII, Latin-1, Latin Extended-A
+    Utf8Letter combining[0x70];             // U+0300..U+036F
+    Utf8Letter deva[0x80];                  // U+0900..U+097F
+    Utf8Letter latin_additional[0x100];     // U+1E00..U+1EFF
+    unsigned char actions[static_cast<int>(Utf8Letter::count)];
+    unsigned char ascii_actions[0x80];
+};
+
+#ifdef SB_UTF8_SSE2
+// index of the lowest set bit; mask isn't 0
+inline unsigned utf8_first_bit(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, mask);
+    return static_cast<unsigned>(i);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// set bits of a 16-bit mask
+inline unsigned utf8_bit_count(unsigned mask) {
+#ifdef _MSC_VER
+    mask = mask - (mask >> 1 & 0x5555);
+    mask = (mask & 0x3333) + (mask >> 2 & 0x3333);
+    mask = (mask + (mask >> 4)) & 0x0f0f;
+    return (mask + (mask >> 8)) & 0x1f;
+#else
+    return static_cast<unsigned>(__builtin_popcount(mask));
+#endif
+}
+#endif
+
+// end of the run of ASCII starting at p
+inline char const * utf8_ascii_run_end(char const * p, char const * end) {
+#ifdef SB_UTF8_SSE2
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(v));
+        if (mask) return p + utf8_first_bit(mask);
+        p += 16;
+    }
+#endif
+    while (p < end && static_cast<unsigned char>(*p) < 0x80) ++p;
+    return p;
+}
+
+// Next code point of a non-ASCII sequence at p, advancing p; malformed
+// bytes are skipped one at a time as U+FFFD.
+inline unsigned utf8_decode(char const * & p, char const * end) {
+    auto byte = [&](std::ptrdiff_t i) { return static_cast<unsigned>(static_cast<unsigned char>(p[i])); };
+    unsigned b0 = byte(0);
+    if (b0 >= 0xc2 && b0 < 0xe0 && end - p >= 2 && (byte(1) & 0xc0) == 0x80) {
+        unsigned cp = (b0 & 0x1f) << 6 | (byte(1) & 0x3f);
+        p += 2;
+        return cp;
+    }
+    if (b0 >= 0xe0 && b0 < 0xf0 && end - p >= 3 && (byte(1) & 0xc0) == 0x80 && (byte(2) & 0xc0) == 0x80) {
+        unsigned cp = (b0 & 0x0f) << 12 | (byte(1) & 0x3f) << 6 | (byte(2) & 0x3f);
+        p += 3;
+        return cp;
+    }
+    if (b0 >= 0xf0 && b0 < 0xf5 && end - p >= 4 && (byte(1) & 0xc0) == 0x80
+        && (byte(2) & 0xc0) == 0x80 && (byte(3) & 0xc0) == 0x80) {
+        unsigned cp = (b0 & 0x07) << 18 | (byte(1) & 0x3f) << 12 | (byte(2) & 0x3f) << 6 | (byte(3) & 0x3f);
+        p += 4;
+        return cp;
+    }
+    ++p;
+    return 0xfffd;
+}
+
+// Counts the syllables of a UTF-8 line into a LinePattern, as
+// encoded_syllables does for ITRANS.
+class Utf8SyllableCounter {
+public:
+    Utf8SyllableCounter(Utf8LetterTable const & letter_table, LinePattern & line_pattern)
+        : table(letter_table), pattern(line_pattern), start_count(line_pattern.count) {}
+
+    int count(char const * p, char const * end) {
+        Registers r = load();
+        while (p < end) {
+            char const * run_end = utf8_ascii_run_end(p, end);
+            if (p < run_end) {
+                settle_inherent_a(r);
+                p = ascii_run(r, p, run_end, end);
+            }
+            // non-ASCII, and anything past max_syllables, whose weights aren't kept
+            while (p < end && (static_cast<unsigned char>(*p) >= 0x80 || r.count >= LinePattern::max_syllables)) {
+                Utf8Letter l = static_cast<unsigned char>(*p) < 0x80 ? table.ascii(static_cast<unsigned char>(*p++))
+                                                                    : table(utf8_decode(p, end));
+                if (Utf8LetterTable::is_simple(l) && r.count < LinePattern::max_syllables) {
+                    settle_inherent_a(r);
+                    step(r, l, p, end);
+                } else {
+                    store(r);
+                    p = letter(l, p, end);
+                    r = load();
+                }
+            }
+        }
+        store(r);
+        if (inherent_a) vowel(false);
+        inherent_a = false;
+        if (consonants >= 2) pattern.make_last_heavy();
+        return pattern.count - start_count;
+    }
+
+    // The count alone, without the light/heavy pattern, which pattern is
+    // left without. Only vowels matter then, so 16 bytes at a time of
+    // anything but combining marks and Devanagari just add theirs; the rest
+    // goes letter by letter. last is kept only as far as counting needs it:
+    // whether a combining dot makes the ASCII r or l before it ṛ or ḷ.
+    int count_only(char const * p, char const * end) {
+        unsigned after_a = 0;           // the letter before was an ASCII a or A
+        char const * blocks_from = p;
+        while (p < end) {
+#ifdef SB_UTF8_SSE2
+            if (p >= blocks_from && !inherent_a) {
+                char const * q = vowel_blocks(p, end, after_a);
+                if (q == p) blocks_from = p + 16;   // not before what stopped it
+                p = q;
+                if (p == end) break;
+            }
+#endif
+            auto c = static_cast<unsigned char>(*p);
+            if (c < 0x80) {
+                if (inherent_a) {
+                    inherent_a = false;
+                    vowel(false);
+                }
+                ++p;
+                unsigned lower = c | 0x20u;
+                unsigned is_iu = (lower == 'i') | (lower == 'u');
+                // ai and au, but not aī or aū written with a combining macron
+                unsigned diphthong = after_a & is_iu;
+                if (diphthong && end - p >= 2 && p[0] == '\xcc' && p[1] == '\x84') diphthong = 0;
+                pattern.count += static_cast<int>(((lower == 'a') | is_iu | (lower == 'e') | (lower == 'o')) & ~diphthong);
+                after_a = lower == 'a';
+                last = table.ascii(c);
+            } else {
+                after_a = 0;
+                Utf8Letter l = table(utf8_decode(p, end));
+                p = letter(l, p, end);
+            }
+        }
+        if (inherent_a) vowel(false);
+        inherent_a = false;
+        return pattern.count - start_count;
+    }
+
+private:
+    // what step() works on, copied out of the members to stay in registers
+    struct Registers {
+        std::uint64_t guru;
+        unsigned count;
+        unsigned consonants;
+        Utf8Letter last;
+    };
+
+    Registers load() const {
+        return Registers{pattern.guru, static_cast<unsigned>(pattern.count),
+                         static_cast<unsigned>(consonants), last};
+    }
+
+    void store(Registers const & r) {
+        pattern.guru = r.guru;
+        pattern.count = static_cast<int>(r.count);
+        consonants = static_cast<int>(r.consonants);
+        last = r.last;
+    }
+
+    // A simple letter, without branching on which it is: it adds
+    // consonants, or is a vowel that closes the syllable before it, or makes
+    // that syllable heavy. Only while count < max_syllables.
+    void step(Registers & r, Utf8Letter l, char const * & p, char const * end) {
+        typedef Utf8LetterTable T;
+        unsigned act = table.action(l);
+        unsigned is_vowel = act / T::act_vowel & 1;
+        // ai and au, but not aī or aū written with a combining macron
+        unsigned next = p < end ? static_cast<unsigned char>(*p) | 0x20u : 0;
+        unsigned diphthong = act / T::act_a & ((next == 'i') | (next == 'u'));
+        if (diphthong && end - p >= 3 && p[1] == '\xcc' && p[2] == '\x84') diphthong = 0;
+        p += diphthong;
+        unsigned is_long = (act / T::act_long | diphthong) & 1;
+        unsigned aspirated = act / T::act_h & (r.last == Utf8Letter::aspirable);    // the h of kh, ṭh...
+        // (heavy << count) >> 1 marks the syllable before, if there is one
+        std::uint64_t heavy_before = (is_vowel & (r.consonants >= 2)) | act / T::act_heavy;
+        r.guru |= (heavy_before << r.count) >> 1 | static_cast<std::uint64_t>(is_vowel & is_long) << r.count;
+        r.count += is_vowel;
+        r.consonants = (r.consonants + (act & 3) - aspirated) & (is_vowel - 1);
+        r.last = aspirated ? Utf8Letter::other : l;
+    }
+
+    // step() for a run of ASCII, which keeps only what the letters do in the
+    // loop; returns where it stopped
+    char const * ascii_run(Registers & r, char const * p, char const * run_end, char const * end) {
+        typedef Utf8LetterTable T;
+        char const * start = p;
+        unsigned after_aspirable = r.last == Utf8Letter::aspirable;
+        unsigned aspirated = 0;
+        while (p < run_end && r.count < LinePattern::max_syllables) {
+            unsigned act = table.ascii_action(static_cast<unsigned char>(*p++));
+            unsigned is_vowel = act / T::act_vowel & 1;
+            unsigned next = p < end ? static_cast<unsigned char>(*p) | 0x20u : 0;
+            unsigned diphthong = act / T::act_a & ((next == 'i') | (next == 'u'));
+            if (diphthong && end - p >= 3 && p[1] == '\xcc' && p[2] == '\x84') diphthong = 0;
+            p += diphthong;
+            unsigned is_long = (act / T::act_long | diphthong) & 1;
+            aspirated = act / T::act_h & after_aspirable;
+            after_aspirable = act / T::act_aspirable & 1;
+            std::uint64_t heavy_before = is_vowel & (r.consonants >= 2);
+            r.guru |= (heavy_before << r.count) >> 1 | static_cast<std::uint64_t>(is_vowel & is_long) << r.count;
+            r.count += is_vowel;
+            r.consonants = (r.consonants + (act & 3) - aspirated) & (is_vowel - 1);
+        }
+        if (p > start) r.last = aspirated ? Utf8Letter::other : table.ascii(static_cast<unsigned char>(p[-1]));
+        return p;
+    }
+
+#ifdef SB_UTF8_SSE2
+    // count_only() for 16-byte blocks from p on, as long as no combining
+    // mark or Devanagari letter starts in a block or right after it: ASCII
+    // vowels less the i or u of each ai and au, and the precomposed IAST
+    // vowels. Returns where it stopped, at the start of a letter.
+    char const * vowel_blocks(char const * p, char const * end, unsigned & after_a) {
+        auto bytes = [](int b) { return _mm_set1_epi8(static_cast<char>(b)); };
+        auto either = [&](__m128i v, int b0, int b1) {
+            return _mm_or_si128(_mm_cmpeq_epi8(v, bytes(b0)), _mm_cmpeq_epi8(v, bytes(b1)));
+        };
+        char const * start = p;
+        unsigned vowels = 0, diphthongs = 0;
+        // reads up to p[17], for letters that start in the block and end past it
+        while (end - p >= 18) {
+            __m128i v0 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p));
+            __m128i v1 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p + 1));
+            __m128i v2 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p + 2));
+            // lead bytes of U+0300..U+037F, U+0800..U+0FFF and U+2000..U+2FFF
+            __m128i slow = _mm_or_si128(either(v1, 0xcc, 0xcd), either(v1, 0xe0, 0xe2));
+            if ((_mm_movemask_epi8(_mm_or_si128(either(v0, 0xcc, 0xcd), either(v0, 0xe0, 0xe2)))
+                 | _mm_movemask_epi8(slow) >> 15) != 0) break;
+            __m128i lower = _mm_or_si128(v0, bytes(0x20));     // bytes from 0x80 stay above 'z'
+            __m128i a = _mm_cmpeq_epi8(lower, bytes('a'));
+            __m128i iu = either(lower, 'i', 'u');
+            // ā ī ū ē ō and capitals: C4 80/81 AA/AB 92/93, C5 AA/AB 8C/8D
+            __m128i odd1 = _mm_or_si128(v1, bytes(1));
+            __m128i two = _mm_or_si128(
+                _mm_and_si128(_mm_cmpeq_epi8(v0, bytes(0xc4)),
+                              _mm_or_si128(either(odd1, 0x81, 0xab), _mm_cmpeq_epi8(odd1, bytes(0x93)))),
+                _mm_and_si128(_mm_cmpeq_epi8(v0, bytes(0xc5)), either(odd1, 0xab, 0x8d)));
+            // ḷ ḹ: E1 B8 B6..B9, ṛ ṝ: E1 B9 9A..9D
+            __m128i odd2 = _mm_or_si128(v2, bytes(1));
+            __m128i three = _mm_and_si128(_mm_cmpeq_epi8(v0, bytes(0xe1)), _mm_or_si128(
+                _mm_and_si128(_mm_cmpeq_epi8(v1, bytes(0xb8)), either(odd2, 0xb7, 0xb9)),
+                _mm_and_si128(_mm_cmpeq_epi8(v1, bytes(0xb9)), either(odd2, 0x9b, 0x9d))));
+            __m128i vowel = _mm_or_si128(_mm_or_si128(a, iu), _mm_or_si128(either(lower, 'e', 'o'),
+                                                                           _mm_or_si128(two, three)));
+            auto a_mask = static_cast<unsigned>(_mm_movemask_epi8(a));
+            vowels += utf8_bit_count(static_cast<unsigned>(_mm_movemask_epi8(vowel)));
+            diphthongs += utf8_bit_count((a_mask << 1 | after_a) & static_cast<unsigned>(_mm_movemask_epi8(iu)));
+            after_a = a_mask >> 15;
+            p += 16;
+        }
+        if (p == start) return p;
+        pattern.count += static_cast<int>(vowels - diphthongs);
+        // only an ASCII r or l matters to a combining dot after it
+        last = static_cast<unsigned char>(p[-1]) < 0x80 ? table.ascii(static_cast<unsigned char>(p[-1]))
+                                                       : Utf8Letter::other;
+        // the rest of a letter that started in the last block
+        while (p < end && (static_cast<unsigned char>(*p) & 0xc0) == 0x80) {
+            ++p;
+            after_a = 0;
+            last = Utf8Letter::other;
+        }
+        return p;
+    }
+#endif
+
+    // a Devanagari consonant followed by something other than a sign has its a
+    void settle_inherent_a(Registers & r) {
+        if (!inherent_a) return;
+        store(r);
+        inherent_a = false;
+        vowel(false);
+        r = load();
+    }
+
+    // a letter in context, one at a time; returns where the next one starts
+    char const * letter(Utf8Letter l, char const * p, char const * end) {
+        if (inherent_a) {
+            switch (l) {
+                case Utf8Letter::deva_short_sign: case Utf8Letter::deva_long_sign:
+                case Utf8Letter::virama: case Utf8Letter::mark:
+                    break;
+                default:
+                    inherent_a = false;
+                    vowel(false);
+            }
+        }
+        Utf8Letter prev = last;
+        last = l;
+        switch (l) {
+            case Utf8Letter::consonant:
+            case Utf8Letter::aspirable:
+                ++consonants;
+                break;
+            case Utf8Letter::h:
+                if (prev == Utf8Letter::aspirable) last = Utf8Letter::other;
+                else ++consonants;
+                break;
+            case Utf8Letter::x:
+                consonants += 2;
+                break;
+            case Utf8Letter::a: {
+                char next = static_cast<char>(p < end ? *p | 0x20 : 0);
+                if ((next == 'i' || next == 'u') && !(end - p >= 3 && p[1] == '\xcc' && p[2] == '\x84')) {
+                    ++p;
+                    vowel(true);
+                } else {
+                    vowel(false);
+                }
+                break;
+            }
+            case Utf8Letter::short_vowel:
+                vowel(false);
+                break;
+            case Utf8Letter::long_vowel:
+                vowel(true);
+                break;
+            case Utf8Letter::heavy:
+                pattern.make_last_heavy();
+                break;
+            case Utf8Letter::deva_consonant:
+                ++consonants;
+                inherent_a = true;
+                break;
+            case Utf8Letter::deva_short_sign:
+            case Utf8Letter::deva_long_sign:
+                inherent_a = false;
+                vowel(l == Utf8Letter::deva_long_sign);
+                break;
+            case Utf8Letter::virama:
+                inherent_a = false;
+                break;
+            case Utf8Letter::mark:
+                last = prev;
+                break;
+            case Utf8Letter::macron:
+                // ā, ī, ū, ṝ written as two code points
+                if (prev == Utf8Letter::a || prev == Utf8Letter::short_vowel) {
+                    pattern.make_last_heavy();
+                    last = Utf8Letter::long_vowel;
+                }
+                break;
+            case Utf8Letter::dot_below:
+            case Utf8Letter::dot_above:
+                last = combine_dot(prev, l == Utf8Letter::dot_below, p);
+                break;
+            case Utf8Letter::other:
+            case Utf8Letter::count:
+                break;
+        }
+        return p;
+    }
+
+    void vowel(bool is_long) {
+        if (consonants >= 2) pattern.make_last_heavy();
+        consonants = 0;
+        pattern.add(is_long);
+    }
+
+    // r, l, h and m followed by a combining dot are ṛ, ḷ, ḥ and ṁ/ṃ; the
+    // consonant they were counted as is taken back. Other dotted letters
+    // (ṭ, ṇ, ṣ...) stay consonants.
+    Utf8Letter combine_dot(Utf8Letter prev, bool below, char const * p) {
+        if (prev != Utf8Letter::consonant && prev != Utf8Letter::h) return prev;
+        // the base letter is ASCII, just before the 2-byte combining mark
+        char base = static_cast<char>(p[-3] | 0x20);
+        if (below && (base == 'r' || base == 'l')) {
+            --consonants;
+            vowel(false);
+            return Utf8Letter::short_vowel;
+        }
+        if ((below && base == 'h') || base == 'm') {
+            --consonants;
+            pattern.make_last_heavy();
+            return Utf8Letter::heavy;
+        }
+        return prev;
+    }
+
+    Utf8LetterTable const & table;
+    LinePattern & pattern;
+    int start_count;
+    int consonants = 0;                 // consonants since the last vowel
+    bool inherent_a = false;            // Devanagari consonant waiting for its vowel
+    Utf8Letter last = Utf8Letter::other;
+};
+
+inline Utf8LetterTable const & utf8_letter_table() {
+    static const Utf8LetterTable table;
+    return table;
+}
+
+inline int utf8_syllables(std::string const & s, LinePattern & pattern) {
+    StatsStage stage(Stage::syllables);
+    Utf8SyllableCounter counter(utf8_letter_table(), pattern);
+    return counter.count(s.data(), s.data() + s.size());
+}
+
+// utf8_syllables without the light/heavy pattern, for when meters aren't
+// wanted
+inline int utf8_syllable_count(std::string const & s) {
+    StatsStage stage(Stage::syllables);
+    LinePattern pattern;
+    Utf8SyllableCounter counter(utf8_letter_table(), pattern);
+    return counter.count_only(s.data(), s.data() + s.size());
+}
+
+#endif
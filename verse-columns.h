@@ -0,0 +1,160 @@
+#ifndef verse_columns_h
+#define verse_columns_h
+
+// Columnar binary file of per-line results (--emit-binary).
+//
+// Layout, native byte order (little-endian on every platform we build for):
+//   Header                       see below, 64 bytes
+//   uint32_t id[rows]            packed verse id, see verse.h
+//   uint16_t syllables[rows]
+//   uint8_t  uvaca[rows]         1 for "... uvaca" lines
+//   uint64_t text_offset[rows+1] text of row i is blob[text_offset[i], text_offset[i+1])
+//   char     blob[]              transliterated (UTF-8) text, not 0-terminated
+// Every column starts at an 8-byte aligned offset recorded in the header,
+// so the reader only maps the file and points into it.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "binary-file.h"
+
+struct VerseColumnsHeader {
+    char magic[8];                  // "SBVERSE\0"
+    std::uint32_t version;
+    std::uint32_t header_size;
+    std::uint64_t rows;
+    std::uint64_t id_offset;
+    std::uint64_t syllables_offset;
+    std::uint64_t uvaca_offset;
+    std::uint64_t text_offset_offset;
+    std::uint64_t blob_offset;
+};
+
+static_assert(sizeof(VerseColumnsHeader) == 64, "VerseColumnsHeader layout");
+
+static char const verse_columns_magic[8] = {'S', 'B', 'V', 'E', 'R', 'S', 'E', '\0'};
+static const std::uint32_t verse_columns_version = 1;
+
+// Collects the columns while counting; the file is written in one go at the end.
+class VerseColumnsWriter {
+public:
+    void add(std::uint32_t id, int syllables, bool uvaca, std::string const & text) {
+        ids.push_back(id);
+        syllable_counts.push_back(static_cast<std::uint16_t>(syllables));
+        uvacas.push_back(uvaca ? 1 : 0);
+        blob.append(text);
+        text_offsets.push_back(blob.size());
+    }
+
+    bool write(char const * path) const {
+        VerseColumnsHeader h{};
+        std::memcpy(h.magic, verse_columns_magic, sizeof(h.magic));
+        h.version = verse_columns_version;
+        h.header_size = sizeof(h);
+        h.rows = ids.size();
+        std::uint64_t pos = sizeof(h);
+        h.id_offset = pos;
+        pos = binary_align(pos + ids.size() * sizeof(ids[0]));
+        h.syllables_offset = pos;
+        pos = binary_align(pos + syllable_counts.size() * sizeof(syllable_counts[0]));
+        h.uvaca_offset = pos;
+        pos = binary_align(pos + uvacas.size());
+        h.text_offset_offset = pos;
+        pos = binary_align(pos + text_offsets.size() * sizeof(text_offsets[0]));
+        h.blob_offset = pos;
+
+        FILE *f = fopen(path, "wb");
+        if (!f) return false;
+        bool ok = binary_put(f, &h, sizeof(h))
+            && binary_put_section(f, h.id_offset, ids.data(), ids.size() * sizeof(ids[0]))
+            && binary_put_section(f, h.syllables_offset, syllable_counts.data(),
+                                  syllable_counts.size() * sizeof(syllable_counts[0]))
+            && binary_put_section(f, h.uvaca_offset, uvacas.data(), uvacas.size())
+            && binary_put_section(f, h.text_offset_offset, text_offsets.data(),
+                                  text_offsets.size() * sizeof(text_offsets[0]))
+            && binary_put_section(f, h.blob_offset, blob.data(), blob.size());
+        return fclose(f) == 0 && ok;
+    }
+
+private:
+    std::vector<std::uint32_t> ids;
+    std::vector<std::uint16_t> syllable_counts;
+    std::vector<std::uint8_t> uvacas;
+    std::vector<std::uint64_t> text_offsets{0};
+    std::string blob;
+};
+
+// Maps a file written by VerseColumnsWriter; accessors point straight into
+// the mapping. Throws std::runtime_error if the file can't be used.
+class VerseColumnsReader {
+public:
+    explicit VerseColumnsReader(char const * path) {
+        if (char const * error = file_.map(path)) fail(error);
+        char const * data = file_.data();
+        std::size_t size = file_.size();
+        if (size < sizeof(VerseColumnsHeader)) fail("file too short");
+        auto h = reinterpret_cast<VerseColumnsHeader const *>(data);
+        if (std::memcmp(h->magic, verse_columns_magic, sizeof(h->magic)) != 0) fail("bad magic");
+        if (h->version != verse_columns_version) fail("unsupported version");
+        if (h->header_size != sizeof(VerseColumnsHeader)) fail("bad header size");
+        // every row takes at least 15 bytes, so this also keeps rows + 1 from overflowing
+        if (h->rows >= size) fail("truncated file");
+        rows_ = static_cast<std::size_t>(h->rows);
+        check_section(h->id_offset, rows_, sizeof(*ids_));
+        check_section(h->syllables_offset, rows_, sizeof(*syllables_));
+        check_section(h->uvaca_offset, rows_, sizeof(*uvacas_));
+        check_section(h->text_offset_offset, rows_ + 1, sizeof(*text_offsets_));
+        check_section(h->blob_offset, 0, 1);
+        ids_ = reinterpret_cast<std::uint32_t const *>(data + h->id_offset);
+        syllables_ = reinterpret_cast<std::uint16_t const *>(data + h->syllables_offset);
+        uvacas_ = reinterpret_cast<std::uint8_t const *>(data + h->uvaca_offset);
+        text_offsets_ = reinterpret_cast<std::uint64_t const *>(data + h->text_offset_offset);
+        blob_ = data + h->blob_offset;
+        // row texts are consecutive slices of the blob
+        std::uint64_t blob_size = size - h->blob_offset;
+        if (text_offsets_[0] != 0) fail("bad text offsets");
+        for (std::size_t row = 0; row < rows_; ++row) {
+            if (text_offsets_[row + 1] < text_offsets_[row]) fail("bad text offsets");
+        }
+        if (text_offsets_[rows_] > blob_size) fail("truncated file");
+    }
+
+    VerseColumnsReader(VerseColumnsReader const &) = delete;
+    VerseColumnsReader & operator=(VerseColumnsReader const &) = delete;
+
+    std::size_t size() const { return rows_; }
+    std::uint32_t id(std::size_t row) const { return ids_[row]; }
+    int syllables(std::size_t row) const { return syllables_[row]; }
+    bool uvaca(std::size_t row) const { return uvacas_[row] != 0; }
+    char const * text_data(std::size_t row) const {
+        return blob_ + text_offsets_[row];
+    }
+    std::size_t text_size(std::size_t row) const {
+        return static_cast<std::size_t>(text_offsets_[row + 1] - text_offsets_[row]);
+    }
+
+private:
+    MappedFile file_;
+    std::size_t rows_ = 0;
+    std::uint32_t const * ids_ = nullptr;
+    std::uint16_t const * syllables_ = nullptr;
+    std::uint8_t const * uvacas_ = nullptr;
+    std::uint64_t const * text_offsets_ = nullptr;
+    char const * blob_ = nullptr;
+
+    void fail(char const * msg) {
+        throw std::runtime_error(std::string("verse columns: ") + msg);
+    }
+
+    // count items of width bytes at offset, aligned and inside the file
+    void check_section(std::uint64_t offset, std::uint64_t count, std::uint64_t width) {
+        if (offset < sizeof(VerseColumnsHeader) || offset % width != 0) fail("bad column offset");
+        if (!file_.holds(offset, count, width)) fail("truncated file");
+    }
+};
+
+#endif
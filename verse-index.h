@@ -0,0 +1,366 @@
+#ifndef verse_index_h
+#define verse_index_h
+
+// Trigram search index over verse text (--index), queried by sb-search.
+//
+// Each document is one verse: the transliterated lines the counter passes
+// to its line sink, grouped by verse id. Text is searched in folded form:
+// IAST diacritics dropped, ASCII lowercased, and everything that isn't a
+// letter removed, spaces included. The editions split compounds and sandhi
+// differently ("yato 'nvayā", "yato'nvayā", "śrī-śuka", "śrīśuka"), so a
+// phrase matches however either edition or the query spaces it.
+// Devanagari passes through unchanged apart from dandas.
+//
+// Layout, native byte order, like verse-columns.h:
+//   Header                       see below, 64 bytes
+//   uint32_t id[docs]            packed verse id, see verse.h
+//   uint64_t text_offset[docs+1] lines of doc i, '\n'-separated, are text[text_offset[i], text_offset[i+1])
+//   uint64_t fold_offset[docs+1] folded doc i is folded[fold_offset[i], fold_offset[i+1])
+//   uint32_t trigram[trigrams]   sorted, three folded bytes b0 << 16 | b1 << 8 | b2
+//   uint64_t posting_offset[trigrams+1]
+//   uint32_t posting[]           ascending doc numbers containing trigram i
+//   char     text[], folded[]
+// Every section starts at an 8-byte aligned offset recorded in the header.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "binary-file.h"
+#include "utf8-syllables.h"
+
+struct VerseIndexHeader {
+    char magic[8];                  // "SBINDEX\0"
+    std::uint32_t version;
+    std::uint32_t docs;
+    std::uint32_t trigrams;
+    std::uint32_t reserved;
+    std::uint64_t id_offset;
+    std::uint64_t text_offset_offset;
+    std::uint64_t fold_offset_offset;
+    std::uint64_t trigram_offset;
+    std::uint64_t posting_offset_offset;
+    // postings, text and folded text follow posting_offset[trigrams+1], in that order
+};
+
+static_assert(sizeof(VerseIndexHeader) == 64, "VerseIndexHeader layout");
+
+static char const verse_index_magic[8] = {'S', 'B', 'I', 'N', 'D', 'E', 'X', '\0'};
+static const std::uint32_t verse_index_version = 1;
+
+// ASCII letter for an IAST letter with diacritics, 0 for anything else
+inline char iast_base_letter(unsigned cp) {
+    switch (cp) {
+    case 0x100: case 0x101: return 'a';
+    case 0x12a: case 0x12b: return 'i';
+    case 0x16a: case 0x16b: return 'u';
+    case 0x1e5a: case 0x1e5b: case 0x1e5c: case 0x1e5d: return 'r';
+    case 0x1e36: case 0x1e37: case 0x1e38: case 0x1e39: return 'l';
+    case 0x1e44: case 0x1e45: case 0x1e46: case 0x1e47: case 0xd1: case 0xf1: return 'n';
+    case 0x1e6c: case 0x1e6d: return 't';
+    case 0x1e0c: case 0x1e0d: return 'd';
+    case 0x15a: case 0x15b: case 0x1e62: case 0x1e63: return 's';
+    case 0x1e40: case 0x1e41: case 0x1e42: case 0x1e43: return 'm';
+    case 0x1e24: case 0x1e25: return 'h';
+    default: return 0;
+    }
+}
+
+// Appends the folded form of [p, end) to out; see the top of the file.
+inline void fold_for_search(char const * p, char const * end, std::string & out) {
+    while (p < end) {
+        auto c = static_cast<unsigned char>(*p);
+        if (c < 0x80) {
+            ++p;
+            if (c >= 'A' && c <= 'Z') out += static_cast<char>(c - 'A' + 'a');
+            else if (c >= 'a' && c <= 'z') out += static_cast<char>(c);
+            continue;
+        }
+        char const * start = p;
+        unsigned cp = utf8_decode(p, end);
+        if (char base = iast_base_letter(cp)) {
+            out += base;
+        } else if ((cp >= 0x300 && cp < 0x370) || cp == 0x964 || cp == 0x965 || cp == 0xfffd) {
+            // combining diacritics of NFD text, dandas
+        } else {
+            out.append(start, p);
+        }
+    }
+}
+
+inline std::uint32_t trigram_at(char const * p) {
+    return static_cast<std::uint32_t>(static_cast<unsigned char>(p[0])) << 16
+        | static_cast<std::uint32_t>(static_cast<unsigned char>(p[1])) << 8
+        | static_cast<std::uint32_t>(static_cast<unsigned char>(p[2]));
+}
+
+// Collects verses while counting; the index is built and written at the end.
+class VerseIndexWriter {
+public:
+    // one line of verse id; consecutive lines of the same id make one document
+    void add(std::uint32_t id, std::string const & line) {
+        if (ids.empty() || ids.back() != id) {
+            ids.push_back(id);
+            text_offsets.push_back(text.size());
+            fold_offsets.push_back(folded.size());
+        } else {
+            text += '\n';
+        }
+        text.append(line);
+        fold_for_search(line.data(), line.data() + line.size(), folded);
+    }
+
+    bool write(char const * path) {
+        text_offsets.push_back(text.size());
+        fold_offsets.push_back(folded.size());
+        build_postings();
+
+        VerseIndexHeader h{};
+        std::memcpy(h.magic, verse_index_magic, sizeof(h.magic));
+        h.version = verse_index_version;
+        h.docs = static_cast<std::uint32_t>(ids.size());
+        h.trigrams = static_cast<std::uint32_t>(trigrams.size());
+        std::uint64_t pos = sizeof(h);
+        h.id_offset = pos;
+        pos = binary_align(pos + ids.size() * sizeof(ids[0]));
+        h.text_offset_offset = pos;
+        pos = binary_align(pos + text_offsets.size() * sizeof(text_offsets[0]));
+        h.fold_offset_offset = pos;
+        pos = binary_align(pos + fold_offsets.size() * sizeof(fold_offsets[0]));
+        h.trigram_offset = pos;
+        pos = binary_align(pos + trigrams.size() * sizeof(trigrams[0]));
+        h.posting_offset_offset = pos;
+        pos = binary_align(pos + posting_offsets.size() * sizeof(posting_offsets[0]));
+        std::uint64_t postings_pos = pos;
+        pos = binary_align(pos + postings.size() * sizeof(postings[0]));
+        std::uint64_t text_pos = pos;
+        pos = binary_align(pos + text.size());
+        std::uint64_t folded_pos = pos;
+
+        FILE *f = fopen(path, "wb");
+        if (!f) return false;
+        bool ok = binary_put(f, &h, sizeof(h))
+            && binary_put_section(f, h.id_offset, ids.data(), ids.size() * sizeof(ids[0]))
+            && binary_put_section(f, h.text_offset_offset, text_offsets.data(),
+                                  text_offsets.size() * sizeof(text_offsets[0]))
+            && binary_put_section(f, h.fold_offset_offset, fold_offsets.data(),
+                                  fold_offsets.size() * sizeof(fold_offsets[0]))
+            && binary_put_section(f, h.trigram_offset, trigrams.data(), trigrams.size() * sizeof(trigrams[0]))
+            && binary_put_section(f, h.posting_offset_offset, posting_offsets.data(),
+                                  posting_offsets.size() * sizeof(posting_offsets[0]))
+            && binary_put_section(f, postings_pos, postings.data(), postings.size() * sizeof(postings[0]))
+            && binary_put_section(f, text_pos, text.data(), text.size())
+            && binary_put_section(f, folded_pos, folded.data(), folded.size());
+        return fclose(f) == 0 && ok;
+    }
+
+private:
+    std::vector<std::uint32_t> ids;
+    std::vector<std::uint64_t> text_offsets;
+    std::vector<std::uint64_t> fold_offsets;
+    std::string text;
+    std::string folded;
+    std::vector<std::uint32_t> trigrams;
+    std::vector<std::uint64_t> posting_offsets;
+    std::vector<std::uint32_t> postings;
+
+    // (trigram, doc) pairs sorted once give both the keys and the postings.
+    // They come out in doc order, so a stable radix sort on the 24-bit
+    // trigram, a byte per pass, is enough.
+    void build_postings() {
+        std::vector<std::uint64_t> pairs, sorted;
+        pairs.reserve(folded.size());
+        for (std::size_t doc = 0; doc < ids.size(); ++doc) {
+            for (auto i = fold_offsets[doc]; i + 3 <= fold_offsets[doc + 1]; ++i) {
+                pairs.push_back(std::uint64_t(trigram_at(&folded[i])) << 32 | doc);
+            }
+        }
+        sorted.resize(pairs.size());
+        for (int shift = 32; shift < 56; shift += 8) {
+            std::size_t starts[257] = {};
+            for (auto pair: pairs) ++starts[((pair >> shift) & 0xff) + 1];
+            for (int b = 0; b < 256; ++b) starts[b + 1] += starts[b];
+            for (auto pair: pairs) sorted[starts[(pair >> shift) & 0xff]++] = pair;
+            pairs.swap(sorted);
+        }
+        pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+        for (auto pair: pairs) {
+            auto trigram = static_cast<std::uint32_t>(pair >> 32);
+            if (trigrams.empty() || trigrams.back() != trigram) {
+                trigrams.push_back(trigram);
+                posting_offsets.push_back(postings.size());
+            }
+            postings.push_back(static_cast<std::uint32_t>(pair));
+        }
+        posting_offsets.push_back(postings.size());
+    }
+};
+
+// Maps a file written by VerseIndexWriter and answers queries straight from
+// the mapping. Throws std::runtime_error if the file can't be used.
+class VerseIndexReader {
+public:
+    explicit VerseIndexReader(char const * path) {
+        if (char const * error = file_.map(path)) fail(error);
+        char const * data = file_.data();
+        if (file_.size() < sizeof(VerseIndexHeader)) fail("file too short");
+        auto h = reinterpret_cast<VerseIndexHeader const *>(data);
+        if (std::memcmp(h->magic, verse_index_magic, sizeof(h->magic)) != 0) fail("bad magic");
+        if (h->version != verse_index_version) fail("unsupported version");
+        docs_ = h->docs;
+        trigram_count_ = h->trigrams;
+        check_section(h->id_offset, docs_, sizeof(*ids_));
+        check_section(h->text_offset_offset, docs_ + 1, sizeof(*text_offsets_));
+        check_section(h->fold_offset_offset, docs_ + 1, sizeof(*fold_offsets_));
+        check_section(h->trigram_offset, trigram_count_, sizeof(*trigrams_));
+        check_section(h->posting_offset_offset, trigram_count_ + 1, sizeof(*posting_offsets_));
+        ids_ = reinterpret_cast<std::uint32_t const *>(data + h->id_offset);
+        text_offsets_ = reinterpret_cast<std::uint64_t const *>(data + h->text_offset_offset);
+        fold_offsets_ = reinterpret_cast<std::uint64_t const *>(data + h->fold_offset_offset);
+        trigrams_ = reinterpret_cast<std::uint32_t const *>(data + h->trigram_offset);
+        posting_offsets_ = reinterpret_cast<std::uint64_t const *>(data + h->posting_offset_offset);
+
+        // postings, text and folded text follow in that order, each sized
+        // by the last of its offsets
+        std::uint64_t pos = binary_align(h->posting_offset_offset + (trigram_count_ + 1) * 8);
+        check_offsets(posting_offsets_, trigram_count_, pos, sizeof(*postings_));
+        postings_ = reinterpret_cast<std::uint32_t const *>(data + pos);
+        pos = binary_align(pos + posting_offsets_[trigram_count_] * 4);
+        check_offsets(text_offsets_, docs_, pos, 1);
+        text_ = data + pos;
+        pos = binary_align(pos + text_offsets_[docs_]);
+        check_offsets(fold_offsets_, docs_, pos, 1);
+        folded_ = data + pos;
+
+        // find() relies on sorted keys, and on postings that are ascending
+        // numbers of real documents
+        for (std::size_t k = 1; k < trigram_count_; ++k) {
+            if (trigrams_[k] <= trigrams_[k - 1]) fail("trigrams out of order");
+        }
+        for (std::size_t k = 0; k < trigram_count_; ++k) {
+            std::uint32_t const * first = postings_ + posting_offsets_[k];
+            std::uint32_t const * end = postings_ + posting_offsets_[k + 1];
+            for (std::uint32_t const * p = first; p < end; ++p) {
+                if (*p >= docs_ || (p > first && *p <= p[-1])) fail("bad postings");
+            }
+        }
+    }
+
+    VerseIndexReader(VerseIndexReader const &) = delete;
+    VerseIndexReader & operator=(VerseIndexReader const &) = delete;
+
+    std::size_t size() const { return docs_; }
+    std::uint32_t id(std::size_t doc) const { return ids_[doc]; }
+    char const * text_data(std::size_t doc) const {
+        return text_ + text_offsets_[doc];
+    }
+    std::size_t text_size(std::size_t doc) const {
+        return static_cast<std::size_t>(text_offsets_[doc + 1] - text_offsets_[doc]);
+    }
+    char const * folded_data(std::size_t doc) const {
+        return folded_ + fold_offsets_[doc];
+    }
+    std::size_t folded_size(std::size_t doc) const {
+        return static_cast<std::size_t>(fold_offsets_[doc + 1] - fold_offsets_[doc]);
+    }
+
+    // Documents whose folded text contains the folded query, in verse order.
+    // Candidates come from intersecting the postings of the query's
+    // trigrams and are then checked against the folded text; queries too
+    // short for a trigram check every document.
+    std::vector<std::size_t> find(std::string const & query) const {
+        std::string q;
+        fold_for_search(query.data(), query.data() + query.size(), q);
+        std::vector<std::size_t> found;
+        if (q.empty()) return found;
+
+        std::vector<std::size_t> candidates;
+        if (q.size() < 3) {
+            candidates.resize(docs_);
+            for (std::size_t doc = 0; doc < docs_; ++doc) candidates[doc] = doc;
+        } else {
+            // shortest postings first, so the candidates only shrink
+            std::vector<std::pair<std::uint32_t const *, std::uint32_t const *>> lists;
+            for (std::size_t i = 0; i + 3 <= q.size(); ++i) {
+                std::uint32_t const * keys_end = trigrams_ + trigram_count_;
+                std::uint32_t const * key = std::lower_bound(trigrams_, keys_end, trigram_at(&q[i]));
+                if (key == keys_end || *key != trigram_at(&q[i])) return found;
+                auto k = static_cast<std::size_t>(key - trigrams_);
+                lists.emplace_back(postings_ + posting_offsets_[k], postings_ + posting_offsets_[k + 1]);
+            }
+            std::sort(lists.begin(), lists.end(), [](std::pair<std::uint32_t const *, std::uint32_t const *> a,
+                                                     std::pair<std::uint32_t const *, std::uint32_t const *> b) {
+                return a.second - a.first < b.second - b.first;
+            });
+            candidates.assign(lists[0].first, lists[0].second);
+            for (std::size_t l = 1; l < lists.size() && !candidates.empty(); ++l) {
+                std::uint32_t const * it = lists[l].first;
+                std::size_t kept = 0;
+                for (auto doc: candidates) {
+                    it = std::lower_bound(it, lists[l].second, doc);
+                    if (it == lists[l].second) break;
+                    if (*it == doc) candidates[kept++] = doc;
+                }
+                candidates.resize(kept);
+            }
+        }
+        for (auto doc: candidates) {
+            char const * begin = folded_ + fold_offsets_[doc];
+            char const * end = folded_ + fold_offsets_[doc + 1];
+            if (contains(begin, end, q)) found.push_back(doc);
+        }
+        return found;
+    }
+
+private:
+    MappedFile file_;
+    std::size_t docs_ = 0;
+    std::size_t trigram_count_ = 0;
+    std::uint32_t const * ids_ = nullptr;
+    std::uint64_t const * text_offsets_ = nullptr;
+    std::uint64_t const * fold_offsets_ = nullptr;
+    std::uint32_t const * trigrams_ = nullptr;
+    std::uint64_t const * posting_offsets_ = nullptr;
+    std::uint32_t const * postings_ = nullptr;
+    char const * text_ = nullptr;
+    char const * folded_ = nullptr;
+
+    // memchr for the first byte does most of the scanning
+    static bool contains(char const * p, char const * end, std::string const & q) {
+        while (end - p >= static_cast<std::ptrdiff_t>(q.size())) {
+            auto first = static_cast<char const *>(
+                std::memchr(p, q[0], static_cast<std::size_t>(end - p) - q.size() + 1));
+            if (!first) return false;
+            if (std::memcmp(first + 1, q.data() + 1, q.size() - 1) == 0) return true;
+            p = first + 1;
+        }
+        return false;
+    }
+
+    void fail(char const * msg) {
+        throw std::runtime_error(std::string("verse index: ") + msg);
+    }
+
+    // count items of width bytes at offset, aligned and inside the file
+    void check_section(std::uint64_t offset, std::uint64_t count, std::uint64_t width) {
+        if (offset < sizeof(VerseIndexHeader) || offset % width != 0) fail("bad section offset");
+        if (!file_.holds(offset, count, width)) fail("truncated file");
+    }
+
+    // offsets[0..count] start at 0 and never decrease, and the section
+    // they index, of items of width bytes, fits at pos
+    void check_offsets(std::uint64_t const * offsets, std::size_t count, std::uint64_t pos, std::uint64_t width) {
+        if (offsets[0] != 0) fail("bad offsets");
+        for (std::size_t i = 0; i < count; ++i) {
+            if (offsets[i + 1] < offsets[i]) fail("bad offsets");
+        }
+        if (!file_.holds(pos, offsets[count], width)) fail("truncated file");
+    }
+};
+
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef verse_stream_h
+#define verse_stream_h
+
+// Verse lines read on demand rather than pushed through a counter's sinks:
+//
+//   VerseStream verses(*in, VerseFormat::rtf);
+//   for (VerseLine const & line: verses) {
+//       if (line.id >= pack_verse_id(1, 4, 0)) break;
+//       ...
+//   }
+//
+// The input is parsed a step at a time (a few KB of RTF, or one ITX line)
+// and only as far as the lines taken, so stopping early skips the rest of
+// the file, and two streams can be read in turns on one thread. The
+// counters still do the work; their line sink fills a buffer of the lines
+// of the current step. Numbering and parse errors are thrown from next()
+// as std::runtime_error.
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "input.h"
+#include "sb-itx-sloka-counter.h"
+#include "sb-sloka-counter.h"
+#include "verse.h"
+
+struct VerseLine {
+    std::uint32_t id = 0;       // packed as in verse.h
+    std::string text;           // transliterated to Unicode
+    int syllables = 0;
+    bool uvaca = false;
+};
+
+// sb.rtf-style RTF, or the numbered lines of bhagpur.itx in ITRANS or UTF-8
+enum class VerseFormat { rtf, itx, itx_utf8 };
+
+class VerseStream {
+public:
+    static const long rtf_step = 4096;      // bytes of RTF parsed per step
+
+    VerseStream(ByteSource & in, VerseFormat format) : in_(in) {
+        auto sink = [this](std::uint32_t id, int syllables, bool uvaca, std::string const & text) {
+            if (pending_size == pending.size()) pending.emplace_back();
+            VerseLine & l = pending[pending_size++];
+            l.id = id;
+            l.text.assign(text);
+            l.syllables = syllables;
+            l.uvaca = uvaca;
+        };
+        if (format == VerseFormat::rtf) {
+            rtf.reset(new RtfParser<SbSlokaCounter>);
+            rtf->GetOutputter().set_print_lines(false);
+            rtf->GetOutputter().set_line_sink(sink);
+            rtf->RtfBegin(in);
+        } else {
+            itx.reset(new SlokaCounter);
+            itx->set_print_lines(false);
+            itx->set_encoding(format == VerseFormat::itx_utf8 ? TextEncoding::utf8 : TextEncoding::itrans);
+            itx->set_line_sink(sink);
+            buf.reset(new SourceStreambuf(in));
+            lines.reset(new std::istream(buf.get()));
+            line.reserve(SlokaCounter::line_capacity);
+        }
+    }
+
+    // the sink points back here
+    VerseStream(VerseStream const &) = delete;
+    VerseStream & operator=(VerseStream const &) = delete;
+
+    // The next line into l, swapping in its text so that buffers are
+    // reused; false at the end of the input.
+    bool next(VerseLine & l) {
+        while (pos == pending_size) {
+            pos = pending_size = 0;
+            if (done) return false;
+            step();
+        }
+        VerseLine & p = pending[pos++];
+        l.id = p.id;
+        l.text.swap(p.text);
+        l.syllables = p.syllables;
+        l.uvaca = p.uvaca;
+        return true;
+    }
+
+    // input iterator over the rest of the lines, for range-for
+    class iterator {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef VerseLine value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef VerseLine const * pointer;
+        typedef VerseLine const & reference;
+
+        iterator() = default;
+        explicit iterator(VerseStream * stream) : stream_(stream) {
+            ++*this;
+        }
+
+        reference operator*() const { return line_; }
+        pointer operator->() const { return &line_; }
+
+        iterator & operator++() {
+            if (!stream_->next(line_)) stream_ = nullptr;
+            return *this;
+        }
+
+        bool operator==(iterator const & other) const { return stream_ == other.stream_; }
+        bool operator!=(iterator const & other) const { return stream_ != other.stream_; }
+
+    private:
+        VerseStream * stream_ = nullptr;
+        VerseLine line_;
+    };
+
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(); }
+
+private:
+    ByteSource & in_;
+    std::unique_ptr<RtfParser<SbSlokaCounter>> rtf;
+    std::unique_ptr<SlokaCounter> itx;
+    std::unique_ptr<SourceStreambuf> buf;
+    std::unique_ptr<std::istream> lines;
+    std::string line;
+    // lines of the last step; entries past pending_size keep their capacity
+    std::vector<VerseLine> pending;
+    std::size_t pending_size = 0;
+    std::size_t pos = 0;
+    bool done = false;
+
+    void step() {
+        if (rtf) {
+            bool finished;
+            Status ec = rtf->RtfParseSome(rtf_step, finished);
+            if (ec == Status::ReadError) throw std::runtime_error(in_.error());
+            if (ec != Status::OK) throw std::runtime_error("error " + std::to_string(int(ec)) + " parsing RTF");
+            done = finished;
+        } else if (std::getline(*lines, line)) {
+            itx->count_line(line);
+        } else {
+            itx->finish();
+            if (!in_.error().empty()) throw std::runtime_error(in_.error());
+            done = true;
+        }
+    }
+};
+
+#endif
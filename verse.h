@@ -0,0 +1,201 @@
+#ifndef verse_h
+#define verse_h
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Verse id packed into 32 bits: canto, chapter, text number and
+// the a/b part used in the odd 4.29.1a-2a numbering.
+// Ordering of packed ids is the natural ordering of verses.
+inline std::uint32_t pack_verse_id(int canto, int chapter, int text, int part = 0) {
+    return (static_cast<std::uint32_t>(canto) << 24)
+        | (static_cast<std::uint32_t>(chapter) << 16)
+        | (static_cast<std::uint32_t>(text) << 4)
+        | static_cast<std::uint32_t>(part);
+}
+
+// "12" -> (12, 0), "1a" -> (1, 1), "2b" -> (2, 2)
+inline std::uint32_t pack_verse_id(std::string const & canto, std::string const & chapter,
+                                   std::string const & text) {
+    int part = 0;
+    if (!text.empty() && (text.back() == 'a' || text.back() == 'b')) {
+        part = text.back() - 'a' + 1;
+    }
+    return pack_verse_id(std::atoi(canto.c_str()), std::atoi(chapter.c_str()),
+                         std::atoi(text.c_str()), part);
+}
+
+inline int verse_canto(std::uint32_t id) { return static_cast<int>(id >> 24); }
+inline int verse_chapter(std::uint32_t id) { return static_cast<int>((id >> 16) & 0xff); }
+inline int verse_text(std::uint32_t id) { return static_cast<int>((id >> 4) & 0xfff); }
+inline int verse_part(std::uint32_t id) { return static_cast<int>(id & 0xf); }
+
+inline std::uint32_t with_verse_text(std::uint32_t id, int text) {
+    return pack_verse_id(verse_canto(id), verse_chapter(id), text);
+}
+
+// "12", "1a"
+inline std::string verse_text_to_string(std::uint32_t id) {
+    std::string s = std::to_string(verse_text(id));
+    if (verse_part(id)) {
+        s += static_cast<char>('a' + verse_part(id) - 1);
+    }
+    return s;
+}
+
+inline std::string verse_id_to_string(std::uint32_t id) {
+    return std::to_string(verse_canto(id)) + '.' + std::to_string(verse_chapter(id))
+        + '.' + verse_text_to_string(id);
+}
+
+// Per-verse result emitted by the counters. A "TEXTS 1-2" range in sb.rtf
+// is a single record with last_text set to the end of the range.
+struct VerseRecord {
+    std::uint32_t id;
+    int last_text;
+    int syllables;
+    int syllables_no_uvaca;
+    std::uint64_t text_hash;    // of the verse lines as read, see add_to_verse_hash
+};
+
+// FNV-1a over the lines of a verse, each followed by a 0 byte. Only
+// comparable between inputs in the same format and transliteration.
+inline std::uint64_t add_to_verse_hash(std::uint64_t hash, std::string const & line) {
+    if (hash == 0) hash = 14695981039346656037ull;
+    for (char c: line) hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    return hash * 1099511628211ull;
+}
+
+// Canto, chapter and text range being read, from sb.rtf's headings or the
+// ITX line numbers, checked against the previous range as each one starts.
+class VerseRange {
+public:
+    VerseRange() = default;
+    void start_text_range(std::string const & text_first, std::string const & text_last="") {
+        text_first_ = text_first;
+        text_last_ = !text_last.empty() ? text_last : text_first;
+        check_numbers();
+    }
+
+    void start_chapter(std::string const & new_canto, std::string const & new_chapter) {
+        canto_ = new_canto;
+        chapter_ = new_chapter;
+    }
+
+    void clear() {
+        text_first_ = ""; text_last_ = "";
+    }
+    bool empty() {
+        return text_first_.empty();
+    }
+    // Numbering errors are fatal, thrown so that buffered output is flushed
+    // first, unless they are being collected for validation.
+    void error(char const * msg) {
+        std::string problem = msg + (": " + canto_ + '.' + chapter_ + '.' + text_first_ + '-' + text_last_
+            + " (previous: " + prev_canto + '.' + prev_chapter + '.' + prev_text + ")");
+        if (!collect) throw std::runtime_error(problem);
+        problems_.push_back(std::move(problem));
+    }
+
+    // record errors in problems() and go on instead of throwing
+    void collect_problems(bool on) {
+        collect = on;
+    }
+
+    std::vector<std::string> const & problems() const {
+        return problems_;
+    }
+
+    int verse_num(std::string const & s) {
+        return atoi(s.c_str());
+    }
+
+    void check_numbers() {
+        if (canto_ != prev_canto) {
+            if (verse_num(canto_) != verse_num(prev_canto)+1) {
+                error("unexpected canto");
+            }
+            if (chapter_ != "1") {
+                error("unexpected chapter");
+            }
+            if (text_first_ != "1") {
+                error("unexpected text number(1)");
+            }
+        } else if (chapter_ != prev_chapter) {
+            if (verse_num(chapter_) != verse_num(prev_chapter)+1) {
+                error("unexpected chapter");
+            }
+            if (text_first_ != "1") {
+                error("unexpected text number(2)");
+            }
+        } else if (verse_num(text_first_) != verse_num(prev_text)+1) {
+            if (canto_ == "4" && chapter_ == "29" && text_first_ == "1a" && prev_text == "85") {
+                // it's OK, no error, just weird numbering in 4.29.85 => 4.29.1a-2a
+            } else if (canto_ == "4" && chapter_ == "29" && text_first_ == "1b" && prev_text == "2a") {
+                // it's OK, no error, just weird numbering in 4.29.1a-2a => 4.29.1b
+            } else {
+                error("unexpected text number(3)");
+            }
+        }
+        if (verse_num(text_last_) < verse_num(text_first_)) {
+            error("unexpected text range");
+        }
+        prev_canto = canto_;
+        prev_chapter = chapter_;
+        prev_text = text_last_;
+    }
+
+    std::string canto() {
+        return canto_;
+    }
+
+    std::string chapter() {
+        return chapter_;
+    }
+
+    std::uint32_t id() {
+        return pack_verse_id(canto_, chapter_, text_first_);
+    }
+
+    std::uint32_t last_id() {
+        return pack_verse_id(canto_, chapter_, text_last_);
+    }
+
+    int last_text() {
+        return verse_num(text_last_);
+    }
+
+private:
+    std::string canto_, chapter_, text_first_, text_last_;
+    std::string prev_canto = "";
+    std::string prev_chapter = "";
+    std::string prev_text = "";
+    bool collect = false;
+    std::vector<std::string> problems_;
+
+    friend std::ostream & operator << (std::ostream & stream, VerseRange & r);
+};
+
+// every problem VerseRange collected, then their count, to stdout; true if
+// there were none
+inline bool print_problems(std::vector<std::string> const & problems) {
+    for (auto & problem: problems) printf("%s\n", problem.c_str());
+    printf("numbering problems: %zu\n", problems.size());
+    return problems.empty();
+}
+
+inline std::ostream & operator << (std::ostream & stream, VerseRange & r) {
+    stream << r.canto_ << '.' << r.chapter_ << '.' << r.text_first_;
+    if (r.text_last_ != r.text_first_) {
+        stream << '-' << r.text_last_;
+    }
+    return stream;
+}
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef word_stats_h
+#define word_stats_h
+
+// Word frequencies gathered in the counting pass (--word-stats), fed by the
+// counters' line sink with transliterated lines.
+//
+// Words are split on spaces, hyphens and any other ASCII non-letter
+// (avagraha, punctuation, digits) and on dandas; ASCII is lowercased. Each
+// word is interned once, so the tables below hold 32-bit ids: a count per
+// id for the whole corpus and for line openings (the first word of every
+// line), and for each chapter a sorted vector of (id, count) pairs.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "arena.h"
+#include "utf8-syllables.h"
+
+// Strings stored once in an arena and numbered in first-seen order. Lookup
+// goes through an open-addressing table of ids with linear probing, kept
+// at most 3/4 full.
+class StringInterner {
+public:
+    std::uint32_t intern(char const * p, std::size_t size) {
+        std::uint32_t hash = fnv1a(p, size);
+        if ((entries.size() + 1) * 4 > slots.size() * 3) grow();
+        std::size_t mask = slots.size() - 1;
+        for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+            std::uint32_t slot = slots[i];
+            if (slot == 0) {
+                auto data = static_cast<char *>(arena.allocate(size, 1));
+                std::memcpy(data, p, size);
+                entries.push_back(Entry{data, static_cast<std::uint32_t>(size), hash});
+                slots[i] = static_cast<std::uint32_t>(entries.size());
+                return slots[i] - 1;
+            }
+            Entry const & e = entries[slot - 1];
+            if (e.hash == hash && e.size == size && std::memcmp(e.data, p, size) == 0) return slot - 1;
+        }
+    }
+
+    std::size_t size() const { return entries.size(); }
+    std::string str(std::uint32_t id) const {
+        return std::string(entries[id].data, entries[id].size);
+    }
+
+    // bytes held: strings, entries and table
+    std::size_t memory() const {
+        return arena.used() + entries.capacity() * sizeof(Entry) + slots.capacity() * sizeof(slots[0]);
+    }
+
+private:
+    struct Entry {
+        char const * data;
+        std::uint32_t size;
+        std::uint32_t hash;
+    };
+
+    Arena arena{64 * 1024};
+    std::vector<Entry> entries;
+    std::vector<std::uint32_t> slots;   // id + 1, 0 for empty
+
+    static std::uint32_t fnv1a(char const * p, std::size_t size) {
+        std::uint32_t h = 2166136261u;
+        for (std::size_t i = 0; i < size; ++i) {
+            h = (h ^ static_cast<unsigned char>(p[i])) * 16777619u;
+        }
+        return h;
+    }
+
+    void grow() {
+        std::vector<std::uint32_t> bigger(slots.empty() ? 1024 : slots.size() * 2);
+        std::size_t mask = bigger.size() - 1;
+        for (std::uint32_t id = 0; id < entries.size(); ++id) {
+            std::size_t i = entries[id].hash & mask;
+            while (bigger[i]) i = (i + 1) & mask;
+            bigger[i] = id + 1;
+        }
+        slots.swap(bigger);
+    }
+};
+
+typedef std::pair<std::uint32_t, std::uint32_t> WordCount;     // id, count
+
+// The k largest counts, largest first, ties in first-seen order; a min-heap
+// of k entries over the candidates.
+class TopWords {
+public:
+    explicit TopWords(std::size_t count) : k(count) {}
+
+    void add(std::uint32_t id, std::uint32_t count) {
+        if (k == 0 || count == 0) return;
+        if (heap.size() < k) {
+            heap.push(WordCount(id, count));
+        } else if (Worse()(WordCount(id, count), heap.top())) {
+            heap.pop();
+            heap.push(WordCount(id, count));
+        }
+    }
+
+    std::vector<WordCount> take() {
+        std::vector<WordCount> result;
+        for (; !heap.empty(); heap.pop()) result.push_back(heap.top());
+        std::reverse(result.begin(), result.end());
+        return result;
+    }
+
+private:
+    // a ranks above b: heap order puts the lowest ranked on top
+    struct Worse {
+        bool operator()(WordCount const & a, WordCount const & b) const {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        }
+    };
+
+    std::size_t k;
+    std::priority_queue<WordCount, std::vector<WordCount>, Worse> heap;
+};
+
+class WordStats {
+public:
+    void add_line(std::uint32_t verse_id, std::string const & text) {
+        std::uint32_t chapter = verse_id >> 16;
+        if (chapters.empty() || chapters.back().chapter != chapter) {
+            close_chapter();
+            chapters.push_back(Chapter{chapter, 0, {}});
+        }
+        bool first = true;
+        char const * end = text.data() + text.size();
+        for (char const * p = text.data(); p < end;) {
+            char const * start = p;
+            word.clear();
+            while (p < end) {
+                auto c = static_cast<unsigned char>(*p);
+                if (c < 0x80) {
+                    if (c >= 'A' && c <= 'Z') word += static_cast<char>(c - 'A' + 'a');
+                    else if (c >= 'a' && c <= 'z') word += static_cast<char>(c);
+                    else break;
+                    ++p;
+                } else {
+                    char const * letter = p;
+                    unsigned cp = utf8_decode(p, end);
+                    if (cp == 0x964 || cp == 0x965) {
+                        p = letter;
+                        break;
+                    }
+                    word.append(letter, p);
+                }
+            }
+            if (p == start) utf8_decode(p, end);   // skip the separator
+            if (word.empty()) continue;
+            std::uint32_t id = words.intern(word.data(), word.size());
+            if (id >= totals.size()) {
+                totals.resize(id + 1);
+                openings.resize(id + 1);
+                chapter_counts.resize(id + 1);
+            }
+            ++totals[id];
+            if (first) ++openings[id];
+            first = false;
+            if (chapter_counts[id]++ == 0) touched.push_back(id);
+            ++chapters.back().tokens;
+            ++tokens;
+        }
+    }
+
+    // Per chapter "words 01.02: T tokens, D distinct: w n, w n..." with the
+    // top k words, then the k most frequent words and line openings overall.
+    void write(FILE * f, std::size_t k) {
+        close_chapter();
+        for (auto & c: chapters) {
+            TopWords top(k);
+            for (auto & wc: c.counts) top.add(wc.first, wc.second);
+            fprintf(f, "words %02u.%02u: %u tokens, %zu distinct:", c.chapter >> 8, c.chapter & 0xff,
+                    c.tokens, c.counts.size());
+            char const * sep = " ";
+            for (auto & wc: top.take()) {
+                fprintf(f, "%s%s %u", sep, words.str(wc.first).c_str(), wc.second);
+                sep = ", ";
+            }
+            fprintf(f, "\n");
+        }
+        fprintf(f, "words: %llu tokens, %zu distinct, %zu KB of tables\n",
+                static_cast<unsigned long long>(tokens), words.size(), memory() / 1024);
+        write_top(f, totals, k);
+        fprintf(f, "line openings:\n");
+        write_top(f, openings, k);
+    }
+
+    std::size_t memory() const {
+        std::size_t bytes = words.memory()
+            + (totals.capacity() + openings.capacity() + chapter_counts.capacity()) * sizeof(std::uint32_t)
+            + chapters.capacity() * sizeof(Chapter);
+        for (auto & c: chapters) bytes += c.counts.capacity() * sizeof(WordCount);
+        return bytes;
+    }
+
+private:
+    struct Chapter {
+        std::uint32_t chapter;          // canto << 8 | chapter
+        std::uint32_t tokens;
+        std::vector<WordCount> counts;  // by id
+    };
+
+    StringInterner words;
+    std::vector<std::uint32_t> totals;          // by id
+    std::vector<std::uint32_t> openings;        // by id
+    std::vector<Chapter> chapters;
+    std::uint64_t tokens = 0;
+    // the open chapter's counts by id, and the ids that are non-zero
+    std::vector<std::uint32_t> chapter_counts;
+    std::vector<std::uint32_t> touched;
+    std::string word;                           // per-word buffer, kept to reuse its capacity
+
+    void close_chapter() {
+        if (touched.empty()) return;
+        std::sort(touched.begin(), touched.end());
+        auto & counts = chapters.back().counts;
+        counts.reserve(touched.size());
+        for (auto id: touched) {
+            counts.push_back(WordCount(id, chapter_counts[id]));
+            chapter_counts[id] = 0;
+        }
+        touched.clear();
+    }
+
+    void write_top(FILE * f, std::vector<std::uint32_t> const & counts, std::size_t k) {
+        TopWords top(k);
+        for (std::uint32_t id = 0; id < counts.size(); ++id) top.add(id, counts[id]);
+        for (auto & wc: top.take()) fprintf(f, "  %s %u\n", words.str(wc.first).c_str(), wc.second);
+    }
+};
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef work_pool_h
+#define work_pool_h
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads with a deque of tasks each. A worker runs its newest task
+// first and, once its own deque is empty, steals the oldest task of another
+// worker. Tasks submitted from a worker go onto that worker's deque, so a
+// task that splits itself up (a large file cut into chunks) spreads over
+// whichever workers are idle without a central queue.
+class WorkPool {
+public:
+    typedef std::function<void()> Task;
+
+    explicit WorkPool(unsigned threads) {
+        if (threads == 0) threads = 1;
+        for (unsigned i = 0; i < threads; ++i) {
+            queues.emplace_back(new Queue);
+        }
+        for (unsigned i = 0; i < threads; ++i) {
+            workers.emplace_back([this, i] { run(i); });
+        }
+    }
+
+    ~WorkPool() {
+        wait();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto & w: workers) w.join();
+    }
+
+    WorkPool(WorkPool const &) = delete;
+    WorkPool & operator=(WorkPool const &) = delete;
+
+    // Tasks must not throw.
+    void submit(Task task) {
+        // counted under the pool lock, so a worker can't take it first
+        std::lock_guard<std::mutex> lock(mutex);
+        std::size_t i = current().pool == this ? current().index : next_queue++ % queues.size();
+        {
+            std::lock_guard<std::mutex> queue_lock(queues[i]->mutex);
+            queues[i]->tasks.push_back(std::move(task));
+        }
+        ++queued;
+        ++pending;
+        wake.notify_one();
+    }
+
+    // until every task, including those submitted by tasks, has finished
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return pending == 0; });
+    }
+
+    std::size_t size() const {
+        return workers.size();
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    struct Worker {
+        WorkPool * pool;
+        std::size_t index;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;       // a task was queued, or stopping
+    std::condition_variable idle;       // pending dropped to 0
+    std::size_t queued = 0;             // in some deque
+    std::size_t pending = 0;            // submitted and not finished
+    std::size_t next_queue = 0;
+    bool stopping = false;
+
+    static Worker & current() {
+        static thread_local Worker worker{nullptr, 0};
+        return worker;
+    }
+
+    bool take(std::size_t self, Task & task) {
+        {
+            Queue & own = *queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (std::size_t k = 1; k < queues.size(); ++k) {
+            Queue & victim = *queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(std::size_t self) {
+        current() = Worker{this, self};
+        for (;;) {
+            Task task;
+            if (take(self, task)) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    --queued;
+                }
+                task();
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0) idle.notify_all();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return queued > 0 || stopping; });
+            if (stopping && queued == 0) return;
+        }
+    }
+};
+
+// A --jobs value: a whole number from 1 to 1024; false for anything else,
+// which would otherwise ask for billions of threads or none.
+inline bool parse_jobs(char const * s, unsigned & jobs) {
+    char * end;
+    errno = 0;
+    long n = std::strtol(s, &end, 10);
+    if (end == s || *end != '\0' || errno == ERANGE || n < 1 || n > 1024) return false;
+    jobs = static_cast<unsigned>(n);
+    return true;
+}
+
+#endif